@@ -0,0 +1,437 @@
+/*!
+  \file bench_eit.c
+
+  Benchmark für make bench: liest alle .eit Dateien (auch unterhalb von
+  Verzeichnissen) und misst die einzelnen Stufen von parse_eit getrennt:
+
+    read      eit_file_load aller Dateien (in einen gemeinsamen Speicher kopiert)
+    walk      eit_parse ohne Textfelder, d.h. Kopf und Descriptor-Schleife
+    decode    eit_parse mit allen Feldern abzüglich walk, also im Wesentlichen
+              die Zeichensatzkonvertierung und das Zusammensetzen der Ketten
+    output    output_event in einen outbuf (ohne fwrite)
+
+  Jede Stufe läuft ROUNDS mal, angegeben wird der schnellste Durchlauf.
+  Vorher werden running_status und free_CA_mode der Dateien von gen_eit
+  (Name NNNNNN.eit) mit den bekannten Werten aus gen_eit.h verglichen, einmal
+  direkt aus eit_parse und einmal aus einer mit eit_columns geschriebenen
+  und wieder eingelesenen --export Datei. Dazu kommen ein paar feste
+  extended_event_descriptor Ketten, deren zusammengesetzter Text bekannt ist.
+
+  bench_eit [-r ROUNDS] [-f json|ndjson|bin] DIR|FILE...
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "parse_eit.h"
+#include "outbuf.h"
+#include "eit_file.h"
+#include "eit_output.h"
+#include "eit_columns.h"
+#include "gen_eit.h"
+
+static char **files = NULL;
+static size_t num_files = 0;
+static size_t max_files = 0;
+
+static void add_file (const char *fn)
+{
+  if (num_files == max_files)
+    {
+      max_files = max_files ? 2 * max_files : 256;
+      files = realloc (files, max_files * sizeof (char *));
+      if (! files)
+        {
+          perror ("realloc");
+          exit (1);
+        }
+    }
+  files[num_files++] = strdup (fn);
+}
+
+static int collect (const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) ftwbuf;
+  size_t len = strlen (fpath);
+  if (typeflag == FTW_F && len > 4 && ! strcasecmp (fpath + len - 4, ".eit"))
+    add_file (fpath);
+  return 0;
+}
+
+static int cmp_filenames (const void *a, const void *b)
+{
+  return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Inhalt aller Dateien hintereinander, offsets[k] .. offsets[k + 1] ist Datei k
+static uint8_t *data = NULL;
+static size_t *offsets = NULL;
+
+static double stage_read (void)
+{
+  struct eit_file in;
+  eit_file_init (&in);
+
+  size_t size = 0, len = 0;
+  double t = now ();
+  for (size_t k = 0; k < num_files; ++k)
+    {
+      offsets[k] = len;
+      if (eit_file_load (&in, files[k]))
+        {
+          perror (files[k]);
+          exit (1);
+        }
+      if (len + in.len > size)
+        {
+          size = 2 * (len + in.len);
+          data = realloc (data, size);
+          if (! data)
+            {
+              perror ("realloc");
+              exit (1);
+            }
+        }
+      memcpy (data + len, in.data, in.len);
+      len += in.len;
+      eit_file_release (&in);
+    }
+  offsets[num_files] = len;
+  t = now () - t;
+
+  eit_file_free (&in);
+  return t;
+}
+
+// Rückgabe Anzahl der Dateien mit Fehlern
+static unsigned parse_all (struct eit_ctx *ctx, double *t)
+{
+  unsigned num_errors = 0;
+  struct eit_event ev;
+  *t = now ();
+  for (size_t k = 0; k < num_files; ++k)
+    if (eit_parse (data + offsets[k], offsets[k + 1] - offsets[k], &ev, ctx))
+      num_errors++;
+  *t = now () - *t;
+  return num_errors;
+}
+
+// Nummer einer Datei von gen_eit, -1 bei anderen Namen
+static long gen_eit_number (const char *fn)
+{
+  const char *base = strrchr (fn, '/');
+  base = base ? base + 1 : fn;
+  char *end;
+  long num = strtol (base, &end, 10);
+  return (end - base == 6 && ! strcmp (end, ".eit")) ? num : -1;
+}
+
+// Rückgabe Anzahl der Dateien mit falschen Kopfdaten
+static unsigned check_header (struct eit_ctx *ctx)
+{
+  unsigned num_wrong = 0;
+  struct eit_event ev;
+  for (size_t k = 0; k < num_files; ++k)
+    {
+      long num = gen_eit_number (files[k]);
+      if (num < 0)
+        continue;
+      eit_parse (data + offsets[k], offsets[k + 1] - offsets[k], &ev, ctx);
+      if (ev.running_status != GEN_EIT_RUNNING_STATUS (num) || ev.free_CA_mode != GEN_EIT_FREE_CA_MODE (num))
+        {
+          if (! num_wrong)
+            fprintf (stderr, "%s: running_status %i, free_CA_mode %i, expected %li and %li\n", files[k],
+                     ev.running_status, ev.free_CA_mode, GEN_EIT_RUNNING_STATUS (num), GEN_EIT_FREE_CA_MODE (num));
+          num_wrong++;
+        }
+    }
+  return num_wrong;
+}
+
+/*
+  Ketten aus zwei extended_event_descriptor: text0 mit der Auswahl der Tabelle, text1 setzt ihn fort.
+  UCS-2 ist an einer Zeichengrenze geteilt, das zweite Fragment beginnt mit dem high byte 0x00.
+*/
+static const struct
+{
+  const char *text0, *text1;
+  uint8_t len0, len1;
+  const char *expected;
+} chains[] =
+{
+  {"\x11\x00H\x00" "a", "\x00l\x00l\x00o", 5, 6, "Hallo"},
+  {"\x11\x00G\x00r", "\x00\xfc\x00n", 5, 4, "Gr\xc3\xbcn"},
+  {"\x15Gr\xc3\xbc", "\x15n", 5, 2, "Gr\xc3\xbcn"},     // dieselbe Auswahl wiederholt
+};
+
+// Rückgabe Anzahl der Ketten mit falschem Text
+static unsigned check_chains (struct eit_ctx *ctx)
+{
+  unsigned num_wrong = 0;
+  for (size_t k = 0; k < sizeof (chains) / sizeof (chains[0]); ++k)
+    {
+      uint8_t buf[12 + 2 * (2 + 6 + 255)] = {0};
+      size_t len = 12;
+      for (int d = 0; d < 2; ++d)
+        {
+          const char *t = d ? chains[k].text1 : chains[k].text0;
+          uint8_t t_len = d ? chains[k].len1 : chains[k].len0;
+          buf[len++] = 0x4E;
+          buf[len++] = 1 + 3 + 1 + 1 + t_len;
+          buf[len++] = d << 4 | 1;
+          memcpy (buf + len, "deu", 3);
+          len += 3;
+          buf[len++] = 0;       // length_of_items
+          buf[len++] = t_len;
+          memcpy (buf + len, t, t_len);
+          len += t_len;
+        }
+      buf[10] = (len - 12) >> 8;
+      buf[11] = (len - 12) & 0xFF;
+
+      struct eit_event ev;
+      int ret = eit_parse (buf, len, &ev, ctx);
+      const char *text = (! ret && ev.num_extended_events == 1) ? ev.extended_events[0].text : NULL;
+      if (! text || strcmp (text, chains[k].expected))
+        {
+          fprintf (stderr, "extended_event chain %zu: '%s', expected '%s'\n", k, text ? text : "(error)",
+                   chains[k].expected);
+          num_wrong++;
+        }
+    }
+  return num_wrong;
+}
+
+// Spalte name aus dem --export Format (eit_columns.h), NULL wenn nicht vorhanden oder kein UINT8
+static const uint8_t *find_uint8_column (const uint8_t *cols, size_t len, const char *name)
+{
+  uint32_t num_columns;
+  uint64_t num_rows;
+  memcpy (&num_columns, cols + 12, 4);
+  memcpy (&num_rows, cols + 16, 8);
+  for (uint32_t k = 0; k < num_columns && 32 + 64 * (k + 1) <= len; ++k)
+    {
+      const uint8_t *desc = cols + 32 + 64 * k;
+      uint32_t type;
+      uint64_t pos, data_len;
+      memcpy (&type, desc + 24, 4);
+      memcpy (&pos, desc + 32, 8);
+      memcpy (&data_len, desc + 40, 8);
+      if (! strncmp ((const char *) desc, name, 24) && type == EIT_COLUMN_UINT8
+          && data_len == num_rows && pos + data_len <= len)
+        return cols + pos;
+    }
+  return NULL;
+}
+
+// Rückgabe Anzahl der Zeilen mit falschen Kopfdaten in der --export Datei, -1 bei Fehlern
+static long check_export (struct eit_ctx *ctx)
+{
+  struct eit_columns *c = eit_columns_new ();
+  char fn[] = "/tmp/bench_eit.XXXXXX";
+  int fd = mkstemp (fn);
+  if (! c || fd < 0)
+    {
+      perror ("check_export");
+      exit (1);
+    }
+  close (fd);
+
+  struct eit_event ev;
+  for (size_t k = 0; k < num_files; ++k)
+    {
+      eit_parse (data + offsets[k], offsets[k + 1] - offsets[k], &ev, ctx);
+      if (eit_columns_add (c, files[k], NULL, &ev))
+        {
+          perror ("eit_columns_add");
+          exit (1);
+        }
+    }
+
+  struct eit_file in;
+  eit_file_init (&in);
+  if (eit_columns_write (c, fn) || eit_file_load (&in, fn))
+    {
+      perror (fn);
+      exit (1);
+    }
+  unlink (fn);
+  eit_columns_free (c);
+
+  long num_wrong = -1;
+  const uint8_t *running_status = (in.len >= 32) ? find_uint8_column (in.data, in.len, "running_status") : NULL;
+  const uint8_t *free_CA_mode = (in.len >= 32) ? find_uint8_column (in.data, in.len, "free_CA_mode") : NULL;
+  if (running_status && free_CA_mode)
+    {
+      num_wrong = 0;
+      for (size_t k = 0; k < num_files; ++k)
+        {
+          long num = gen_eit_number (files[k]);
+          if (num >= 0 && (running_status[k] != GEN_EIT_RUNNING_STATUS (num) || free_CA_mode[k] != GEN_EIT_FREE_CA_MODE (num)))
+            num_wrong++;
+        }
+    }
+  eit_file_free (&in);
+  return num_wrong;
+}
+
+static double stage_output (struct eit_ctx *ctx, enum output_format fmt, size_t *out_len)
+{
+  struct outbuf out;
+  outbuf_init (&out);
+  struct eit_event ev;
+  double t = 0;
+  *out_len = 0;
+  for (size_t k = 0; k < num_files; ++k)
+    {
+      int ret = eit_parse (data + offsets[k], offsets[k + 1] - offsets[k], &ev, ctx);
+      double t0 = now ();
+      if (fmt == OUTPUT_JSON)
+        output_json_head (&out, files[k], NULL);
+      output_event (&out, fmt, EIT_FIELD_ALL, files[k], NULL, &ev, ret ? eit_ctx_errmsg (ctx) : NULL);
+      t += now () - t0;
+      *out_len += out.len;
+      out.len = 0;
+    }
+  outbuf_free (&out);
+  return t;
+}
+
+static void report (const char *stage, double t, double mb)
+{
+  printf ("%-8s %10.4f %12.0f %10.1f\n", stage, t, num_files / t, mb / t);
+}
+
+static void usage (const char *prog)
+{
+  fprintf (stderr, "usage: %s [-r ROUNDS] [-f json|ndjson|bin] DIR|FILE...\n", prog);
+  exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+  int rounds = 3;
+  int fmt = OUTPUT_JSON;
+  int opt;
+  while ((opt = getopt (argc, argv, "r:f:")) != -1)
+    switch (opt)
+      {
+      case 'r':
+        rounds = atoi (optarg);
+        if (rounds < 1)
+          usage (argv[0]);
+        break;
+      case 'f':
+        fmt = output_format_from_name (optarg);
+        if (fmt < 0)
+          usage (argv[0]);
+        break;
+      default:
+        usage (argv[0]);
+      }
+  if (optind == argc)
+    usage (argv[0]);
+
+  for (int k = optind; k < argc; ++k)
+    {
+      struct stat st;
+      if (! stat (argv[k], &st) && S_ISDIR (st.st_mode))
+        {
+          size_t first = num_files;
+          nftw (argv[k], collect, 20, FTW_PHYS);
+          qsort (files + first, num_files - first, sizeof (char *), cmp_filenames);
+        }
+      else
+        add_file (argv[k]);
+    }
+  if (! num_files)
+    {
+      fprintf (stderr, "no .eit files found\n");
+      return 1;
+    }
+
+  offsets = malloc ((num_files + 1) * sizeof (size_t));
+  if (! offsets)
+    {
+      perror ("malloc");
+      return 1;
+    }
+
+  struct eit_ctx ctx;
+  eit_ctx_init (&ctx);
+
+  stage_read ();
+  eit_ctx_set_fields (&ctx, 0);
+  unsigned num_wrong = check_header (&ctx);
+  if (num_wrong)
+    fprintf (stderr, "%u files with wrong running_status or free_CA_mode\n", num_wrong);
+  long num_wrong_export = check_export (&ctx);
+  if (num_wrong_export < 0)
+    fprintf (stderr, "running_status or free_CA_mode missing in the export\n");
+  else if (num_wrong_export)
+    fprintf (stderr, "%li rows with wrong running_status or free_CA_mode in the export\n", num_wrong_export);
+  if (num_wrong_export)
+    num_wrong++;
+  eit_ctx_set_fields (&ctx, EIT_FIELD_ALL);
+  num_wrong += check_chains (&ctx);
+
+  double best[4] = {0, 0, 0, 0};
+  unsigned num_errors = 0;
+  size_t out_len = 0;
+  for (int r = 0; r < rounds; ++r)
+    {
+      double t[4], full;
+      t[0] = stage_read ();
+
+      // nur die Descriptoren ohne Text werden ausgewertet, alle anderen über descriptor_length übersprungen
+      eit_ctx_set_fields (&ctx, EIT_FIELD_ALL & ~(EIT_FIELD_EVENT_NAME | EIT_FIELD_TEXT | EIT_FIELD_EXTENDED | EIT_FIELD_COMPONENT));
+      parse_all (&ctx, &t[1]);
+
+      eit_ctx_set_fields (&ctx, EIT_FIELD_ALL);
+      num_errors = parse_all (&ctx, &full);
+      t[2] = (full > t[1]) ? full - t[1] : 0;
+
+      t[3] = stage_output (&ctx, fmt, &out_len);
+
+      for (int s = 0; s < 4; ++s)
+        if (! r || t[s] < best[s])
+          best[s] = t[s];
+    }
+
+  double mb = offsets[num_files] / 1e6;
+  printf ("%zu files, %.1f MB, %u with errors, %.1f MB output, best of %i rounds\n\n",
+          num_files, mb, num_errors, out_len / 1e6, rounds);
+  printf ("%-8s %10s %12s %10s\n", "stage", "seconds", "files/s", "MB/s");
+
+  static const char *names[] = {"read", "walk", "decode", "output"};
+  double total = 0;
+  for (int s = 0; s < 4; ++s)
+    {
+      report (names[s], best[s], mb);
+      total += best[s];
+    }
+  report ("total", total, mb);
+
+  eit_ctx_free (&ctx);
+  for (size_t k = 0; k < num_files; ++k)
+    free (files[k]);
+  free (files);
+  free (offsets);
+  free (data);
+  return num_errors != 0 || num_wrong != 0;
+}
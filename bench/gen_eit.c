@@ -0,0 +1,431 @@
+/*!
+  \file gen_eit.c
+
+  Erzeugt für make bench einen synthetischen Korpus von Enigma2 .eit Dateien
+  nach EN 300 468: short_event_descriptor, verkettete extended_event_descriptor
+  (mit items, der Text wird ohne Rücksicht auf UTF-8 Zeichengrenzen auf die
+  Descriptoren verteilt), component, content, parental_rating und ein paar
+  unbekannte Descriptoren. Die Texte benutzen verschiedene Zeichentabellen
+  nach Annex A, damit sowohl die eingebauten Decoder als auch iconv drankommen,
+  und enthalten auch die Steuerzeichen aus Annex A.1.
+
+  gen_eit DIR [NUM [SEED]]
+
+  Gleiche NUM und SEED ergeben immer denselben Korpus. Die Datei NNNNNN.eit
+  hat running_status und free_CA_mode aus gen_eit.h, damit sich die Kopfdaten
+  des Parsers gegen bekannte Werte prüfen lassen.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "gen_eit.h"
+
+// xorshift64*, rand () ist nicht auf allen libc gleich
+static uint64_t s_rng;
+
+static uint32_t rnd (uint32_t n)
+{
+  s_rng ^= s_rng >> 12;
+  s_rng ^= s_rng << 25;
+  s_rng ^= s_rng >> 27;
+  return (uint32_t) ((s_rng * 0x2545F4914F6CDD1DULL) >> 32) % n;
+}
+
+static const char *german_words[] =
+{
+  "Sheldon", "Leonard", "Penny", "Howard", "Raj", "Wohnung", "Physiker", "Überraschung",
+  "Geburtstag", "Mädchen", "Straße", "Größe", "fährt", "müssen", "Kühlschrank", "Schlüssel",
+  "Prüfung", "Universität", "Abendessen", "Freundin", "plötzlich", "während", "Geschäft",
+  "Rätsel", "Lösung", "Höhle", "Schneewelt", "Gäste", "natürlich", "für", "über", "und",
+  "der", "die", "das", "mit", "sich", "nicht", "eine", "wird", "Zeit", "endlich", "Abenteuer",
+  "\"Star Trek\"", "Comic-Laden", "Experiment", "Konferenz", "Nachbarin", "Büro", "schön",
+  "Fußball", "Bär", "Ärger", "Öl", "Übung", "heißt", "weiß", "außerdem", "Familie,", "Stadt.",
+  // nur in Tabellen mit Euro-Zeichen
+  "5 €"
+};
+
+static const char *russian_words[] =
+{
+  "Шелдон", "Леонард", "Пенни", "квартира", "физик", "сюрприз", "день", "рождения",
+  "девушка", "улица", "университет", "ужин", "внезапно", "и", "в", "не", "на", "с", "время",
+  "наконец", "приключение", "эксперимент", "соседка", "семья,", "город."
+};
+
+#define NUM_GERMAN (sizeof (german_words) / sizeof (german_words[0]))
+#define NUM_RUSSIAN (sizeof (russian_words) / sizeof (russian_words[0]))
+
+enum encoding
+{
+  ENC_LATIN1,     // auch ISO-8859-9, für die Wörter oben identisch
+  ENC_8859_15,
+  ENC_8859_5,
+  ENC_UTF8
+};
+
+// Annex A, Tabelle A.3 und A.4: Auswahlbytes am Anfang jedes Textfelds
+static const struct
+{
+  const char *prefix;
+  size_t prefix_len;
+  enum encoding enc;
+  unsigned weight;    // Anteil in Prozent
+} tables[] =
+{
+  {"", 0, ENC_LATIN1, 30},              // Default Latin-1 (Tabelle 00)
+  {"\x05", 1, ENC_LATIN1, 30},          // ISO-8859-9
+  {"\x15", 1, ENC_UTF8, 20},            // UTF-8
+  {"\x0B", 1, ENC_8859_15, 8},          // ISO-8859-15
+  {"\x10\x00\x0F", 3, ENC_8859_15, 7},  // ISO-8859-15 über 0x10
+  {"\x01", 1, ENC_8859_5, 5}            // ISO-8859-5, geht über iconv
+};
+
+// liest ein UTF-8 Zeichen aus den (gültigen) Wortlisten
+static uint32_t next_cp (const char **s)
+{
+  const uint8_t *p = (const uint8_t *) *s;
+  uint32_t cp = p[0];
+  int n = 1;
+  if (cp >= 0xE0)
+    {
+      cp = (cp & 0x0F) << 12 | (p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+      n = 3;
+    }
+  else if (cp >= 0xC0)
+    {
+      cp = (cp & 0x1F) << 6 | (p[1] & 0x3F);
+      n = 2;
+    }
+  *s += n;
+  return cp;
+}
+
+struct s_text
+{
+  uint8_t buf[4096];
+  size_t len;
+};
+
+static void put_byte (struct s_text *t, uint8_t c)
+{
+  if (t->len < sizeof (t->buf))
+    t->buf[t->len++] = c;
+}
+
+// hängt das UTF-8 Wort w in der Kodierung enc an
+static void put_word (struct s_text *t, enum encoding enc, const char *w)
+{
+  if (enc == ENC_UTF8)
+    {
+      while (*w)
+        put_byte (t, *w++);
+      return;
+    }
+
+  while (*w)
+    {
+      uint32_t cp = next_cp (&w);
+      if (enc == ENC_8859_15 && cp == 0x20AC)
+        cp = 0xA4;
+      else if (enc == ENC_8859_5 && cp >= 0x410 && cp <= 0x44F)
+        cp -= 0x360;
+      else if (cp > 0xFF)
+        cp = '?';
+      put_byte (t, cp);
+    }
+}
+
+// Annex A.1 Steuerzeichen (0x86/0x87 Hervorhebung, 0x8A CR/LF), in UTF-8 als U+0086..
+static void put_control (struct s_text *t, enum encoding enc, uint8_t code)
+{
+  if (enc == ENC_UTF8)
+    put_byte (t, 0xC2);
+  put_byte (t, code);
+}
+
+// Text aus num_words zufälligen Wörtern, höchstens max_len Bytes inklusive der Auswahlbytes
+static void make_text (struct s_text *t, unsigned table, unsigned num_words, size_t max_len)
+{
+  enum encoding enc = tables[table].enc;
+  t->len = 0;
+  for (size_t k = 0; k < tables[table].prefix_len; ++k)
+    put_byte (t, tables[table].prefix[k]);
+
+  for (unsigned k = 0; k < num_words; ++k)
+    {
+      const char *w;
+      if (enc == ENC_8859_5)
+        w = russian_words[rnd (NUM_RUSSIAN)];
+      else
+        w = german_words[rnd ((enc == ENC_LATIN1) ? NUM_GERMAN - 1 : NUM_GERMAN)];
+
+      size_t before = t->len;
+      if (k)
+        put_byte (t, ' ');
+      // ab und zu ein Zeilenumbruch oder ein hervorgehobenes Wort
+      unsigned r = rnd (40);
+      if (r == 0)
+        put_control (t, enc, 0x8A);
+      if (r == 1)
+        put_control (t, enc, 0x86);
+      put_word (t, enc, w);
+      if (r == 1)
+        put_control (t, enc, 0x87);
+      if (t->len > max_len)
+        {
+          t->len = before;
+          break;
+        }
+    }
+}
+
+struct s_eit
+{
+  uint8_t buf[12 + 4095];
+  size_t len;
+};
+
+static void put (struct s_eit *e, const void *p, size_t n)
+{
+  if (e->len + n > sizeof (e->buf))
+    {
+      fprintf (stderr, "gen_eit: descriptor loop too long\n");
+      exit (1);
+    }
+  memcpy (e->buf + e->len, p, n);
+  e->len += n;
+}
+
+static void put_u8 (struct s_eit *e, uint8_t v)
+{
+  put (e, &v, 1);
+}
+
+static uint8_t bcd (unsigned v)
+{
+  return (v / 10) << 4 | (v % 10);
+}
+
+static void put_short_event (struct s_eit *e, unsigned table, const char *lang)
+{
+  struct s_text name, text;
+  make_text (&name, table, 1 + rnd (5), 80);
+  // descriptor_length = 3 + 1 + name + 1 + text <= 255
+  make_text (&text, table, 5 + rnd (30), 250 - name.len);
+
+  put_u8 (e, 0x4D);
+  put_u8 (e, 3 + 1 + name.len + 1 + text.len);
+  put (e, lang, 3);
+  put_u8 (e, name.len);
+  put (e, name.buf, name.len);
+  put_u8 (e, text.len);
+  put (e, text.buf, text.len);
+}
+
+static const char *item_names[] = {"Regie", "Darsteller", "Drehbuch", "Produktion", "Originaltitel"};
+
+static void put_extended_events (struct s_eit *e, unsigned table, const char *lang)
+{
+  struct s_text text;
+  make_text (&text, table, 40 + rnd (300), 2000);
+
+  // die Auswahlbytes stehen nur vor dem ersten Teil, der Parser setzt die Teile vor dem Dekodieren zusammen
+  size_t chunk = 200 + rnd (40);
+  unsigned num = (text.len + chunk - 1) / chunk;
+  if (num > 12)
+    num = 12;
+
+  size_t pos = 0;
+  for (unsigned k = 0; k < num; ++k)
+    {
+      struct s_text items[4];
+      unsigned num_items = (k == 0) ? rnd (3) : 0;
+      size_t items_len = 0;
+      for (unsigned j = 0; j < num_items; ++j)
+        {
+          struct s_text *desc = &items[2 * j];
+          desc->len = 0;
+          for (size_t i = 0; i < tables[table].prefix_len; ++i)
+            put_byte (desc, tables[table].prefix[i]);
+          put_word (desc, ENC_LATIN1, item_names[rnd (5)]);
+          make_text (&items[2 * j + 1], table, 2, 30);
+          items_len += 2 + items[2 * j].len + items[2 * j + 1].len;
+        }
+
+      size_t n = text.len - pos;
+      if (n > chunk)
+        n = chunk;
+      if (n > 249 - items_len)
+        n = 249 - items_len;
+
+      put_u8 (e, 0x4E);
+      put_u8 (e, 1 + 3 + 1 + items_len + 1 + n);
+      put_u8 (e, k << 4 | (num - 1));
+      put (e, lang, 3);
+      put_u8 (e, items_len);
+      for (unsigned j = 0; j < 2 * num_items; ++j)
+        {
+          put_u8 (e, items[j].len);
+          put (e, items[j].buf, items[j].len);
+        }
+      put_u8 (e, n);
+      put (e, text.buf + pos, n);
+      pos += n;
+    }
+}
+
+static void put_components (struct s_eit *e, unsigned table, const char *lang)
+{
+  // Tabelle 26: Video 16:9 HD, Stereo, AC-3, Untertitel
+  static const uint8_t kinds[][2] = {{0x05, 0x0B}, {0x02, 0x03}, {0x04, 0x44}, {0x03, 0x10}};
+  static const char *texts[] = {"", "HD", "Stereo", "Dolby Digital", "Untertitel"};
+
+  unsigned num = 1 + rnd (3);
+  for (unsigned k = 0; k < num; ++k)
+    {
+      struct s_text text;
+      unsigned t = rnd (5);
+      text.len = 0;
+      if (*texts[t])
+        {
+          for (size_t j = 0; j < tables[table].prefix_len; ++j)
+            put_byte (&text, tables[table].prefix[j]);
+          put_word (&text, ENC_LATIN1, texts[t]);
+        }
+
+      unsigned kind = rnd (4);
+      put_u8 (e, 0x50);
+      put_u8 (e, 6 + text.len);
+      put_u8 (e, kinds[kind][0]);
+      put_u8 (e, kinds[kind][1]);
+      put_u8 (e, k + 1);
+      put (e, lang, 3);
+      put (e, text.buf, text.len);
+    }
+}
+
+static void put_content (struct s_eit *e)
+{
+  unsigned num = 1 + rnd (2);
+  put_u8 (e, 0x54);
+  put_u8 (e, 2 * num);
+  for (unsigned k = 0; k < num; ++k)
+    {
+      put_u8 (e, (1 + rnd (11)) << 4 | rnd (8));
+      put_u8 (e, rnd (256));
+    }
+}
+
+static void put_parental_rating (struct s_eit *e)
+{
+  put_u8 (e, 0x55);
+  put_u8 (e, 4);
+  put (e, "DEU", 3);
+  put_u8 (e, rnd (16));
+}
+
+// Descriptoren, die parse_eit nicht auswertet (private_data_specifier, data_broadcast_id)
+static void put_unknown (struct s_eit *e)
+{
+  static const uint8_t pds[] = {0x5F, 4, 0x00, 0x00, 0x00, 0x02};
+  static const uint8_t dbi[] = {0x66, 2, 0x01, 0x06};
+  if (rnd (2))
+    put (e, pds, sizeof (pds));
+  else
+    put (e, dbi, sizeof (dbi));
+}
+
+// Datei num bekommt running_status und free_CA_mode wie gen_eit_status, bench_eit prüft das nach
+static void make_eit (struct s_eit *e, unsigned long num)
+{
+  unsigned r = rnd (100);
+  unsigned table = 0;
+  while (r >= tables[table].weight)
+    r -= tables[table++].weight;
+  const char *lang = (tables[table].enc == ENC_8859_5) ? "rus" : "deu";
+
+  e->len = 0;
+  uint16_t event_id = rnd (65536);
+  put_u8 (e, event_id >> 8);
+  put_u8 (e, event_id);
+
+  // start_time: MJD zwischen 2011 und 2025, dann UTC als BCD
+  uint16_t mjd = 55562 + rnd (15 * 365);
+  put_u8 (e, mjd >> 8);
+  put_u8 (e, mjd);
+  put_u8 (e, bcd (rnd (24)));
+  put_u8 (e, bcd (rnd (12) * 5));
+  put_u8 (e, bcd (0));
+
+  unsigned minutes = 15 + 5 * rnd (34);
+  put_u8 (e, bcd (minutes / 60));
+  put_u8 (e, bcd (minutes % 60));
+  put_u8 (e, bcd (0));
+
+  // running_status, free_CA_mode und descriptors_loop_length werden zum Schluss gesetzt
+  size_t status = e->len;
+  put_u8 (e, 0);
+  put_u8 (e, 0);
+
+  put_short_event (e, table, lang);
+  if (rnd (10) < 9)
+    put_extended_events (e, table, lang);
+  put_components (e, table, lang);
+  if (rnd (10) < 8)
+    put_content (e);
+  if (rnd (2))
+    put_parental_rating (e);
+  if (rnd (4) == 0)
+    put_unknown (e);
+
+  size_t loop_len = e->len - 12;
+  e->buf[status] = GEN_EIT_RUNNING_STATUS (num) << 5 | GEN_EIT_FREE_CA_MODE (num) << 4 | loop_len >> 8;
+  e->buf[status + 1] = loop_len & 0xFF;
+}
+
+int main (int argc, char *argv[])
+{
+  if (argc < 2 || argc > 4)
+    {
+      fprintf (stderr, "usage: %s DIR [NUM [SEED]]\n", argv[0]);
+      return 1;
+    }
+
+  const char *dir = argv[1];
+  unsigned long num = (argc > 2) ? strtoul (argv[2], NULL, 10) : 10000;
+  s_rng = (argc > 3) ? strtoull (argv[3], NULL, 10) : 1;
+  s_rng = s_rng * 0x9E3779B97F4A7C15ULL | 1;
+
+  if (mkdir (dir, 0777) && errno != EEXIST)
+    {
+      perror (dir);
+      return 1;
+    }
+
+  char *fn = malloc (strlen (dir) + 32);
+  if (! fn)
+    {
+      perror ("malloc");
+      return 1;
+    }
+
+  static struct s_eit e;
+  for (unsigned long k = 0; k < num; ++k)
+    {
+      make_eit (&e, k);
+      sprintf (fn, "%s/%06lu.eit", dir, k);
+      FILE *f = fopen (fn, "wb");
+      if (! f || fwrite (e.buf, 1, e.len, f) != e.len || fclose (f))
+        {
+          perror (fn);
+          return 1;
+        }
+    }
+
+  free (fn);
+  return 0;
+}
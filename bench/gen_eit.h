@@ -0,0 +1,15 @@
+/*!
+  \file gen_eit.h
+
+  Bekannte Kopfdaten der von gen_eit erzeugten Dateien: Datei NNNNNN.eit hat
+  running_status NNNNNN % 5 und free_CA_mode (NNNNNN / 5) % 2, so kommen alle
+  Kombinationen vor. bench_eit vergleicht das Ergebnis von eit_parse damit.
+*/
+
+#ifndef GEN_EIT_H
+#define GEN_EIT_H
+
+#define GEN_EIT_RUNNING_STATUS(num) ((num) % 5)
+#define GEN_EIT_FREE_CA_MODE(num) (((num) / 5) % 2)
+
+#endif
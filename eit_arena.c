@@ -0,0 +1,112 @@
+/*!
+  \file eit_arena.c
+
+  Bump Allocator für die Strings eines eit_event. Alles wird in einem Rutsch
+  beim nächsten eit_parse freigegeben, der erste Block bleibt dabei erhalten
+  und wird für die nächste Datei wiederverwendet.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "eit_internal.h"
+
+struct eit_arena_chunk
+{
+  struct eit_arena_chunk *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+#define ARENA_ALIGN 8
+#define ARENA_MIN_CHUNK 4096
+
+static struct eit_arena_chunk *new_chunk (size_t size)
+{
+  struct eit_arena_chunk *c = malloc (sizeof (struct eit_arena_chunk) + size);
+  if (c)
+    {
+      c->next = NULL;
+      c->size = size;
+      c->used = 0;
+    }
+  return c;
+}
+
+static void free_chunks (struct eit_arena_chunk *c)
+{
+  while (c)
+    {
+      struct eit_arena_chunk *next = c->next;
+      free (c);
+      c = next;
+    }
+}
+
+int eit_arena_reset (struct eit_ctx *ctx, size_t hint)
+{
+  struct eit_arena_chunk *first = ctx->arena;
+
+  if (first)
+    {
+      free_chunks (first->next);
+      first->next = NULL;
+      first->used = 0;
+    }
+
+  if (! first || first->size < hint)
+    {
+      if (hint < ARENA_MIN_CHUNK)
+        hint = ARENA_MIN_CHUNK;
+      free (first);
+      first = new_chunk (hint);
+    }
+
+  ctx->arena = ctx->arena_cur = first;
+  return first ? EIT_OK : EIT_ERR_NOMEM;
+}
+
+void eit_arena_free (struct eit_ctx *ctx)
+{
+  free_chunks (ctx->arena);
+  ctx->arena = ctx->arena_cur = NULL;
+}
+
+void *eit_alloc (struct eit_ctx *ctx, size_t size)
+{
+  struct eit_arena_chunk *c = ctx->arena_cur;
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+  if (! c || c->size - c->used < size)
+    {
+      // reicht die Schätzung aus eit_parse nicht, einen weiteren Block anhängen
+      size_t n = c ? 2 * c->size : ARENA_MIN_CHUNK;
+      if (n < size)
+        n = size;
+
+      struct eit_arena_chunk *tmp = new_chunk (n);
+      if (! tmp)
+        return NULL;
+      if (c)
+        c->next = tmp;
+      else
+        ctx->arena = tmp;
+      ctx->arena_cur = c = tmp;
+    }
+
+  void *p = c->data + c->used;
+  c->used += size;
+  return p;
+}
+
+void eit_arena_shrink (struct eit_ctx *ctx, void *p, size_t old_size, size_t new_size)
+{
+  struct eit_arena_chunk *c = ctx->arena_cur;
+  old_size = (old_size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  new_size = (new_size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+  // nur die zuletzt angelegte Allokation kann verkleinert werden
+  if (c && (char *) p + old_size == c->data + c->used && new_size <= old_size)
+    c->used -= old_size - new_size;
+}
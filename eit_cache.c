@@ -0,0 +1,304 @@
+/*!
+  \file eit_cache.c
+
+  Cache für --cache, siehe eit_cache.h
+
+  Dateiformat (native byte order, die Datei ist nur für diesen Rechner):
+
+    "PEITCACHE1\n", uint32_t 0x01020304, uint32_t format, uint32_t Anzahl Einträge
+    je Eintrag:
+      uint32_t path_len, uint32_t data_len, int64_t size, int64_t mtime_sec, int64_t mtime_nsec,
+      path (ohne Nullbyte), data
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "eit_cache.h"
+
+#define CACHE_MAGIC "PEITCACHE1\n"
+#define CACHE_BOM 0x01020304
+
+struct s_cache_entry
+{
+  char *path;         // NULL = freier Platz
+  char *data;
+  uint32_t data_len;
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t hash;
+  char used;          // in diesem Lauf benutzt, wird gespeichert
+};
+
+struct eit_cache
+{
+  char *fn;
+  unsigned format;
+
+  struct s_cache_entry *entries;  // open addressing, Größe ist Zweierpotenz
+  size_t size;
+  size_t num;
+
+  pthread_mutex_t lock;
+};
+
+static uint64_t hash_path (const char *s)
+{
+  // FNV-1a
+  uint64_t h = 0xcbf29ce484222325ULL;
+  while (*s)
+    h = (h ^ (uint8_t) *s++) * 0x100000001b3ULL;
+  return h;
+}
+
+static struct s_cache_entry *find_slot (struct eit_cache *c, const char *path, uint64_t h)
+{
+  size_t mask = c->size - 1;
+  for (size_t k = h & mask;; k = (k + 1) & mask)
+    {
+      struct s_cache_entry *e = &c->entries[k];
+      if (! e->path || (e->hash == h && ! strcmp (e->path, path)))
+        return e;
+    }
+}
+
+static int grow_table (struct eit_cache *c)
+{
+  size_t old_size = c->size;
+  struct s_cache_entry *old = c->entries;
+
+  c->size = old_size ? 2 * old_size : 1024;
+  c->entries = calloc (c->size, sizeof (struct s_cache_entry));
+  if (! c->entries)
+    {
+      c->entries = old;
+      c->size = old_size;
+      return -1;
+    }
+
+  for (size_t k = 0; k < old_size; ++k)
+    if (old[k].path)
+      *find_slot (c, old[k].path, old[k].hash) = old[k];
+  free (old);
+  return 0;
+}
+
+// neuer Eintrag, übernimmt path und data
+static struct s_cache_entry *insert (struct eit_cache *c, char *path, char *data, uint32_t data_len)
+{
+  // Füllgrad höchstens 1/2
+  if (2 * (c->num + 1) > c->size && grow_table (c))
+    return NULL;
+
+  uint64_t h = hash_path (path);
+  struct s_cache_entry *e = find_slot (c, path, h);
+  if (e->path)
+    {
+      free (e->path);
+      free (e->data);
+    }
+  else
+    c->num++;
+
+  memset (e, 0, sizeof (*e));
+  e->path = path;
+  e->data = data;
+  e->data_len = data_len;
+  e->hash = h;
+  return e;
+}
+
+static int read_all (FILE *f, void *p, size_t n)
+{
+  return fread (p, 1, n, f) == n ? 0 : -1;
+}
+
+static void load (struct eit_cache *c, FILE *f)
+{
+  char magic[sizeof (CACHE_MAGIC) - 1];
+  uint32_t hdr[3];
+
+  if (read_all (f, magic, sizeof (magic)) || memcmp (magic, CACHE_MAGIC, sizeof (magic))
+      || read_all (f, hdr, sizeof (hdr)) || hdr[0] != CACHE_BOM || hdr[1] != c->format)
+    {
+      fprintf (stderr, "WARNING: ignoring cache %s (other version or format)\n", c->fn);
+      return;
+    }
+
+  for (uint32_t k = 0; k < hdr[2]; ++k)
+    {
+      uint32_t len[2];
+      int64_t st[3];
+      if (read_all (f, len, sizeof (len)) || read_all (f, st, sizeof (st)))
+        break;
+
+      char *path = malloc (len[0] + 1);
+      char *data = malloc (len[1] ? len[1] : 1);
+      if (! path || ! data || read_all (f, path, len[0]) || read_all (f, data, len[1]))
+        {
+          free (path);
+          free (data);
+          break;
+        }
+      path[len[0]] = 0;
+
+      struct s_cache_entry *e = insert (c, path, data, len[1]);
+      if (! e)
+        {
+          free (path);
+          free (data);
+          break;
+        }
+      e->size = st[0];
+      e->mtime_sec = st[1];
+      e->mtime_nsec = st[2];
+    }
+}
+
+struct eit_cache *eit_cache_open (const char *fn, unsigned format)
+{
+  struct eit_cache *c = calloc (1, sizeof (struct eit_cache));
+  if (! c)
+    return NULL;
+
+  c->fn = strdup (fn);
+  c->format = format;
+  pthread_mutex_init (&c->lock, NULL);
+  if (! c->fn || grow_table (c))
+    {
+      free (c->fn);
+      free (c);
+      return NULL;
+    }
+
+  FILE *f = fopen (fn, "rb");
+  if (f)
+    {
+      load (c, f);
+      fclose (f);
+    }
+  else if (errno != ENOENT)
+    fprintf (stderr, "WARNING: cannot read cache %s: %s\n", fn, strerror (errno));
+
+  return c;
+}
+
+static int matches (const struct s_cache_entry *e, const struct stat *st)
+{
+  return e->size == (int64_t) st->st_size
+         && e->mtime_sec == (int64_t) st->st_mtim.tv_sec
+         && e->mtime_nsec == (int64_t) st->st_mtim.tv_nsec;
+}
+
+int eit_cache_get (struct eit_cache *c, const char *path, const struct stat *st, struct outbuf *out)
+{
+  int hit = 0;
+  pthread_mutex_lock (&c->lock);
+
+  struct s_cache_entry *e = find_slot (c, path, hash_path (path));
+  if (e->path && matches (e, st))
+    {
+      outbuf_put (out, e->data, e->data_len);
+      e->used = 1;
+      hit = 1;
+    }
+
+  pthread_mutex_unlock (&c->lock);
+  return hit;
+}
+
+void eit_cache_put (struct eit_cache *c, const char *path, const struct stat *st, const char *data, size_t len)
+{
+  char *p = strdup (path);
+  char *d = malloc (len ? len : 1);
+  if (! p || ! d || len > UINT32_MAX)
+    {
+      free (p);
+      free (d);
+      return;
+    }
+  memcpy (d, data, len);
+
+  pthread_mutex_lock (&c->lock);
+  struct s_cache_entry *e = insert (c, p, d, len);
+  if (e)
+    {
+      e->size = st->st_size;
+      e->mtime_sec = st->st_mtim.tv_sec;
+      e->mtime_nsec = st->st_mtim.tv_nsec;
+      e->used = 1;
+    }
+  else
+    {
+      free (p);
+      free (d);
+    }
+  pthread_mutex_unlock (&c->lock);
+}
+
+static int save (struct eit_cache *c)
+{
+  size_t len = strlen (c->fn);
+  char tmp_fn[len + 5];
+  memcpy (tmp_fn, c->fn, len);
+  memcpy (tmp_fn + len, ".tmp", 5);
+
+  FILE *f = fopen (tmp_fn, "wb");
+  if (! f)
+    return -1;
+
+  uint32_t num = 0;
+  for (size_t k = 0; k < c->size; ++k)
+    num += c->entries[k].path && c->entries[k].used;
+
+  uint32_t hdr[3] = {CACHE_BOM, c->format, num};
+  fwrite (CACHE_MAGIC, 1, sizeof (CACHE_MAGIC) - 1, f);
+  fwrite (hdr, 1, sizeof (hdr), f);
+
+  for (size_t k = 0; k < c->size; ++k)
+    {
+      const struct s_cache_entry *e = &c->entries[k];
+      if (! e->path || ! e->used)
+        continue;
+
+      uint32_t lens[2] = {strlen (e->path), e->data_len};
+      int64_t st[3] = {e->size, e->mtime_sec, e->mtime_nsec};
+      fwrite (lens, 1, sizeof (lens), f);
+      fwrite (st, 1, sizeof (st), f);
+      fwrite (e->path, 1, lens[0], f);
+      fwrite (e->data, 1, lens[1], f);
+    }
+
+  int ret = ferror (f) ? -1 : 0;
+  if (fclose (f))
+    ret = -1;
+  if (! ret)
+    ret = rename (tmp_fn, c->fn);
+  if (ret)
+    remove (tmp_fn);
+  return ret;
+}
+
+int eit_cache_close (struct eit_cache *c)
+{
+  int ret = save (c);
+  if (ret)
+    fprintf (stderr, "ERROR: cannot write cache %s: %s\n", c->fn, strerror (errno));
+
+  for (size_t k = 0; k < c->size; ++k)
+    {
+      free (c->entries[k].path);
+      free (c->entries[k].data);
+    }
+  free (c->entries);
+  free (c->fn);
+  pthread_mutex_destroy (&c->lock);
+  free (c);
+  return ret;
+}
@@ -0,0 +1,40 @@
+/*!
+  \file eit_cache.h
+
+  --cache FILE: merkt sich die Ausgabe jeder Datei zusammen mit Pfad, Größe
+  und mtime. Bei einem erneuten Lauf werden unveränderte Dateien nicht mehr
+  gelesen, sondern ihre gespeicherte Ausgabe eingefügt.
+*/
+
+#ifndef EIT_CACHE_H
+#define EIT_CACHE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "outbuf.h"
+
+struct eit_cache;
+
+/*
+  Lädt FILE (fehlt die Datei, ist der Cache leer). format unterscheidet
+  verschiedene Ausgabeformate, ein Cache eines anderen Formats wird verworfen.
+*/
+struct eit_cache *eit_cache_open (const char *fn, unsigned format);
+
+/*
+  Hängt die gespeicherte Ausgabe für path an out an, wenn Größe und mtime
+  zu st passen. Rückgabe 1 bei einem Treffer, sonst 0. Thread-safe.
+*/
+int eit_cache_get (struct eit_cache *c, const char *path, const struct stat *st, struct outbuf *out);
+
+// speichert die Ausgabe data für path, Thread-safe
+void eit_cache_put (struct eit_cache *c, const char *path, const struct stat *st, const char *data, size_t len);
+
+/*
+  Schreibt alle in diesem Lauf benutzten Einträge (Treffer und neue) zurück,
+  Einträge nicht mehr vorhandener Dateien fallen dabei heraus. Rückgabe -1 bei Fehler.
+*/
+int eit_cache_close (struct eit_cache *c);
+
+#endif
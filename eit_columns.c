@@ -0,0 +1,387 @@
+/*!
+  \file eit_columns.c
+
+  Spaltenweiser Export für --export, Dateiformat siehe eit_columns.h
+
+  Spalten: filename, service_id, transport_stream_id, original_network_id,
+  event_id, start_time (Sekunden seit 1970, INT64_MIN wenn undefiniert),
+  duration (Sekunden), running_status, free_CA_mode, language, title, text
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "eit_columns.h"
+#include "eit_token.h"
+
+#define COLUMNS_MAGIC "PEITCOL1"
+#define COLUMNS_BOM 0x01020304
+
+struct s_columns_header
+{
+  char magic[8];
+  uint32_t bom;
+  uint32_t num_columns;
+  uint64_t num_rows;
+  uint64_t reserved;
+};
+
+struct s_column_desc
+{
+  char name[24];
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t data;
+  uint64_t data_len;
+  uint64_t dict;
+  uint64_t dict_count;
+};
+
+_Static_assert (sizeof (struct s_columns_header) == 32, "columns header must be 32 bytes");
+_Static_assert (sizeof (struct s_column_desc) == 64, "column description must be 64 bytes");
+
+// Hashtabelle String -> Index, die Strings liegen hintereinander in pool
+struct s_dict
+{
+  uint32_t *slots;      // Index + 1, 0 = frei
+  size_t size;          // Zweierpotenz
+
+  uint64_t *offsets;    // count + 1 Einträge
+  size_t count;
+  size_t max_count;
+
+  char *pool;
+  size_t pool_len;
+  size_t pool_size;
+};
+
+struct s_column
+{
+  const char *name;
+  enum eit_column_type type;
+  size_t elem_size;
+
+  uint8_t *data;
+  size_t len;           // in Byte
+  size_t size;
+
+  struct s_dict dict;
+};
+
+enum
+{
+  COL_FILENAME,
+  COL_SERVICE_ID,
+  COL_TRANSPORT_STREAM_ID,
+  COL_ORIGINAL_NETWORK_ID,
+  COL_EVENT_ID,
+  COL_START_TIME,
+  COL_DURATION,
+  COL_RUNNING_STATUS,
+  COL_FREE_CA_MODE,
+  COL_LANGUAGE,
+  COL_TITLE,
+  COL_TEXT,
+  NUM_COLUMNS
+};
+
+struct eit_columns
+{
+  struct s_column col[NUM_COLUMNS];
+  uint64_t num_rows;
+
+  // letzter Dateiname, bei Streams kommen viele Events aus derselben Datei
+  const char *last_fn;
+  uint32_t last_fn_idx;
+};
+
+static const struct
+{
+  const char *name;
+  enum eit_column_type type;
+} s_column_types[NUM_COLUMNS] =
+{
+  [COL_FILENAME] = {"filename", EIT_COLUMN_DICT},
+  [COL_SERVICE_ID] = {"service_id", EIT_COLUMN_UINT16},
+  [COL_TRANSPORT_STREAM_ID] = {"transport_stream_id", EIT_COLUMN_UINT16},
+  [COL_ORIGINAL_NETWORK_ID] = {"original_network_id", EIT_COLUMN_UINT16},
+  [COL_EVENT_ID] = {"event_id", EIT_COLUMN_UINT16},
+  [COL_START_TIME] = {"start_time", EIT_COLUMN_INT64},
+  [COL_DURATION] = {"duration", EIT_COLUMN_INT32},
+  [COL_RUNNING_STATUS] = {"running_status", EIT_COLUMN_UINT8},
+  [COL_FREE_CA_MODE] = {"free_CA_mode", EIT_COLUMN_UINT8},
+  [COL_LANGUAGE] = {"language", EIT_COLUMN_DICT},
+  [COL_TITLE] = {"title", EIT_COLUMN_DICT},
+  [COL_TEXT] = {"text", EIT_COLUMN_DICT}
+};
+
+static size_t type_size (enum eit_column_type type)
+{
+  switch (type)
+    {
+    case EIT_COLUMN_UINT8:
+      return 1;
+    case EIT_COLUMN_UINT16:
+      return 2;
+    case EIT_COLUMN_INT32:
+    case EIT_COLUMN_DICT:
+      return 4;
+    case EIT_COLUMN_INT64:
+      return 8;
+    }
+  return 0;
+}
+
+struct eit_columns *eit_columns_new (void)
+{
+  struct eit_columns *c = calloc (1, sizeof (*c));
+  if (! c)
+    return NULL;
+  for (int k = 0; k < NUM_COLUMNS; ++k)
+    {
+      c->col[k].name = s_column_types[k].name;
+      c->col[k].type = s_column_types[k].type;
+      c->col[k].elem_size = type_size (c->col[k].type);
+    }
+  return c;
+}
+
+static int append (struct s_column *col, const void *v)
+{
+  if (col->size - col->len < col->elem_size)
+    {
+      size_t size = col->size ? 2 * col->size : 4096;
+      uint8_t *tmp = realloc (col->data, size);
+      if (! tmp)
+        return -1;
+      col->data = tmp;
+      col->size = size;
+    }
+  memcpy (col->data + col->len, v, col->elem_size);
+  col->len += col->elem_size;
+  return 0;
+}
+
+static int grow_slots (struct s_dict *d)
+{
+  size_t size = d->size ? 2 * d->size : 1024;
+  uint32_t *slots = calloc (size, sizeof (uint32_t));
+  if (! slots)
+    return -1;
+  for (size_t k = 0; k < d->count; ++k)
+    {
+      const char *s = d->pool + d->offsets[k];
+      size_t pos = eit_token_hash (s, d->offsets[k + 1] - d->offsets[k]) & (size - 1);
+      while (slots[pos])
+        pos = (pos + 1) & (size - 1);
+      slots[pos] = k + 1;
+    }
+  free (d->slots);
+  d->slots = slots;
+  d->size = size;
+  return 0;
+}
+
+// Index von s im Dictionary, neue Strings werden angehängt. Rückgabe -1 bei Speichermangel
+static int64_t dict_lookup (struct s_dict *d, const char *s)
+{
+  if (! d->offsets)
+    {
+      d->offsets = malloc (256 * sizeof (uint64_t));
+      if (! d->offsets)
+        return -1;
+      d->max_count = 255;
+      d->offsets[0] = 0;
+    }
+  if (2 * (d->count + 1) > d->size && grow_slots (d))
+    return -1;
+
+  size_t len = strlen (s);
+  size_t pos = eit_token_hash (s, len) & (d->size - 1);
+  while (d->slots[pos])
+    {
+      uint32_t k = d->slots[pos] - 1;
+      if (d->offsets[k + 1] - d->offsets[k] == len && ! memcmp (d->pool + d->offsets[k], s, len))
+        return k;
+      pos = (pos + 1) & (d->size - 1);
+    }
+
+  if (d->count == d->max_count)
+    {
+      size_t max = 2 * (d->max_count + 1);
+      uint64_t *tmp = realloc (d->offsets, max * sizeof (uint64_t));
+      if (! tmp)
+        return -1;
+      d->offsets = tmp;
+      d->max_count = max - 1;
+    }
+  if (d->pool_size - d->pool_len < len)
+    {
+      size_t size = d->pool_size ? 2 * d->pool_size : 65536;
+      while (size - d->pool_len < len)
+        size *= 2;
+      char *tmp = realloc (d->pool, size);
+      if (! tmp)
+        return -1;
+      d->pool = tmp;
+      d->pool_size = size;
+    }
+
+  memcpy (d->pool + d->pool_len, s, len);
+  d->pool_len += len;
+  d->offsets[++d->count] = d->pool_len;
+  d->slots[pos] = d->count;
+  return d->count - 1;
+}
+
+static int append_string (struct s_column *col, const char *s)
+{
+  uint32_t idx = EIT_COLUMN_NULL;
+  if (s)
+    {
+      int64_t k = dict_lookup (&col->dict, s);
+      if (k < 0)
+        return -1;
+      idx = k;
+    }
+  return append (col, &idx);
+}
+
+int eit_columns_add (struct eit_columns *c, const char *fn, const struct eit_section *sec, const struct eit_event *ev)
+{
+  struct s_column *col = c->col;
+
+  uint32_t fn_idx = c->last_fn_idx;
+  if (fn != c->last_fn)
+    {
+      int64_t k = dict_lookup (&col[COL_FILENAME].dict, fn);
+      if (k < 0)
+        return -1;
+      fn_idx = c->last_fn_idx = k;
+      c->last_fn = fn;
+    }
+
+  uint16_t service_id = sec ? sec->service_id : 0;
+  uint16_t transport_stream_id = sec ? sec->transport_stream_id : 0;
+  uint16_t original_network_id = sec ? sec->original_network_id : 0;
+  int64_t start_time = ev->start_time.undefined ? INT64_MIN : ev->start_time.unix_time;
+  int32_t duration = ev->duration.hour * 3600 + ev->duration.minute * 60 + ev->duration.second;
+  const struct eit_short_event *se = ev->num_short_events ? &ev->short_events[0] : NULL;
+
+  int err = append (&col[COL_FILENAME], &fn_idx)
+            || append (&col[COL_SERVICE_ID], &service_id)
+            || append (&col[COL_TRANSPORT_STREAM_ID], &transport_stream_id)
+            || append (&col[COL_ORIGINAL_NETWORK_ID], &original_network_id)
+            || append (&col[COL_EVENT_ID], &ev->event_id)
+            || append (&col[COL_START_TIME], &start_time)
+            || append (&col[COL_DURATION], &duration)
+            || append (&col[COL_RUNNING_STATUS], &ev->running_status)
+            || append (&col[COL_FREE_CA_MODE], &ev->free_CA_mode)
+            || append_string (&col[COL_LANGUAGE], se ? se->language : NULL)
+            || append_string (&col[COL_TITLE], se ? se->event_name : NULL)
+            || append_string (&col[COL_TEXT], se ? se->text : NULL);
+  if (err)
+    return -1;
+
+  c->num_rows++;
+  return 0;
+}
+
+static uint64_t align8 (uint64_t v)
+{
+  return (v + 7) & ~(uint64_t) 7;
+}
+
+// schreibt n Byte und füllt danach bis zur nächsten 8 Byte Grenze mit 0 auf
+static int put_aligned (FILE *f, const void *p, size_t n)
+{
+  static const char zero[8];
+  return (! n || fwrite (p, 1, n, f) == n)
+         && fwrite (zero, 1, align8 (n) - n, f) == align8 (n) - n;
+}
+
+static int write_columns (FILE *f, struct eit_columns *c)
+{
+  struct s_columns_header h;
+  memset (&h, 0, sizeof (h));
+  memcpy (h.magic, COLUMNS_MAGIC, sizeof (h.magic));
+  h.bom = COLUMNS_BOM;
+  h.num_columns = NUM_COLUMNS;
+  h.num_rows = c->num_rows;
+
+  struct s_column_desc desc[NUM_COLUMNS];
+  memset (desc, 0, sizeof (desc));
+  uint64_t pos = sizeof (h) + sizeof (desc);
+  for (int k = 0; k < NUM_COLUMNS; ++k)
+    {
+      const struct s_column *col = &c->col[k];
+      strncpy (desc[k].name, col->name, sizeof (desc[k].name) - 1);
+      desc[k].type = col->type;
+      desc[k].data = pos;
+      desc[k].data_len = col->len;
+      pos += align8 (col->len);
+      if (col->type == EIT_COLUMN_DICT)
+        {
+          desc[k].dict = pos;
+          desc[k].dict_count = col->dict.count;
+          pos += (col->dict.count + 1) * sizeof (uint64_t) + align8 (col->dict.pool_len);
+        }
+    }
+
+  if (fwrite (&h, sizeof (h), 1, f) != 1 || fwrite (desc, sizeof (desc), 1, f) != 1)
+    return -1;
+
+  static const uint64_t no_offsets[1] = {0};
+  for (int k = 0; k < NUM_COLUMNS; ++k)
+    {
+      const struct s_column *col = &c->col[k];
+      if (! put_aligned (f, col->data, col->len))
+        return -1;
+      if (col->type != EIT_COLUMN_DICT)
+        continue;
+
+      const uint64_t *offsets = col->dict.offsets ? col->dict.offsets : no_offsets;
+      if (fwrite (offsets, sizeof (uint64_t), col->dict.count + 1, f) != col->dict.count + 1
+          || ! put_aligned (f, col->dict.pool, col->dict.pool_len))
+        return -1;
+    }
+  return 0;
+}
+
+int eit_columns_write (struct eit_columns *c, const char *fn)
+{
+  char tmp_fn[strlen (fn) + 5];
+  snprintf (tmp_fn, sizeof (tmp_fn), "%s.tmp", fn);
+
+  FILE *f = fopen (tmp_fn, "wb");
+  if (! f)
+    return -1;
+
+  int err = write_columns (f, c);
+  if (fclose (f) || err || rename (tmp_fn, fn))
+    {
+      int e = errno;
+      unlink (tmp_fn);
+      errno = e;
+      return -1;
+    }
+  return 0;
+}
+
+void eit_columns_free (struct eit_columns *c)
+{
+  if (! c)
+    return;
+  for (int k = 0; k < NUM_COLUMNS; ++k)
+    {
+      free (c->col[k].data);
+      free (c->col[k].dict.slots);
+      free (c->col[k].dict.offsets);
+      free (c->col[k].dict.pool);
+    }
+  free (c);
+}
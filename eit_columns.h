@@ -0,0 +1,59 @@
+/*!
+  \file eit_columns.h
+
+  --export FILE: schreibt alle Events spaltenweise in eine Datei, die von
+  Analyseprogrammen direkt per mmap gelesen werden kann (z.B. numpy.memmap),
+  statt das JSON zu parsen. Strings sind dictionary-kodiert, die vielen
+  gleichen Titel einer Serie stehen nur einmal in der Datei.
+
+  Dateiformat (native byte order wie beim Cache, alle Offsets ab Dateianfang,
+  alle Bereiche auf 8 Byte ausgerichtet):
+
+    Kopf, 32 Byte:
+      char magic[8] "PEITCOL1", uint32_t 0x01020304, uint32_t num_columns,
+      uint64_t num_rows, uint64_t 0
+    num_columns x 64 Byte Spaltenbeschreibung:
+      char name[24] (null-terminiert), uint32_t type, uint32_t 0,
+      uint64_t data, uint64_t data_len, uint64_t dict, uint64_t dict_count
+    die Daten der Spalten: num_rows Werte des Typs
+
+  Typen (enum eit_column_type): UINT8, UINT16, INT32, INT64 und DICT. DICT
+  sind uint32_t Indizes in das Dictionary der Spalte, EIT_COLUMN_NULL für
+  fehlende Strings. Das Dictionary bei dict: (dict_count + 1) x uint64_t
+  Offsets wie bei Arrow, danach die UTF-8 Bytes; String k sind die Bytes
+  offsets[k] .. offsets[k + 1] ab dem Ende der Offsets.
+*/
+
+#ifndef EIT_COLUMNS_H
+#define EIT_COLUMNS_H
+
+#include "parse_eit.h"
+
+enum eit_column_type
+{
+  EIT_COLUMN_UINT8 = 1,
+  EIT_COLUMN_UINT16 = 2,
+  EIT_COLUMN_INT32 = 3,
+  EIT_COLUMN_INT64 = 4,
+  EIT_COLUMN_DICT = 5
+};
+
+#define EIT_COLUMN_NULL 0xFFFFFFFFu
+
+struct eit_columns;
+
+struct eit_columns *eit_columns_new (void);
+
+/*
+  Eine Zeile für ev, sec ist NULL bei .eit Dateien (service_id usw. sind dann 0).
+  language, title und text stammen aus dem ersten short_event_descriptor.
+  Rückgabe -1 bei Speichermangel.
+*/
+int eit_columns_add (struct eit_columns *c, const char *fn, const struct eit_section *sec, const struct eit_event *ev);
+
+// Rückgabe -1 und errno bei Fehler
+int eit_columns_write (struct eit_columns *c, const char *fn);
+
+void eit_columns_free (struct eit_columns *c);
+
+#endif
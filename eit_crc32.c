@@ -0,0 +1,64 @@
+/*!
+  \file eit_crc32.c
+
+  CRC_32 der sections nach ISO/IEC 13818-1 Annex A (CRC-32/MPEG-2):
+  Polynom 0x04C11DB7, MSB first, Startwert 0xFFFFFFFF, kein abschließendes XOR.
+  Über eine ganze section inklusive CRC_32 gerechnet ist das Ergebnis 0.
+
+  slice-by-8: pro Schritt 8 Byte über 8 Tabellen zu je 256 Einträgen. Die
+  CRC Befehle von ARMv8 und SSE4.2 rechnen mit gespiegelten Bits (bzw.
+  einem anderen Polynom) und passen deshalb nicht.
+*/
+
+#include <string.h>
+#include <pthread.h>
+
+#include "eit_internal.h"
+
+#define CRC32_MPEG2_POLY 0x04C11DB7
+
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void init_crc_table (void)
+{
+  for (uint32_t b = 0; b < 256; ++b)
+    {
+      uint32_t c = b << 24;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 0x80000000) ? (c << 1) ^ CRC32_MPEG2_POLY : c << 1;
+      crc_table[0][b] = c;
+    }
+
+  // crc_table[k][b]: Byte b gefolgt von k Nullbytes
+  for (int k = 1; k < 8; ++k)
+    for (int b = 0; b < 256; ++b)
+      crc_table[k][b] = (crc_table[k - 1][b] << 8) ^ crc_table[0][crc_table[k - 1][b] >> 24];
+}
+
+static inline uint32_t load_be32 (const uint8_t *p)
+{
+  return (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+uint32_t eit_crc32 (const uint8_t *p, size_t len)
+{
+  pthread_once (&crc_table_once, init_crc_table);
+
+  uint32_t crc = 0xFFFFFFFF;
+
+  for (; len >= 8; p += 8, len -= 8)
+    {
+      uint32_t hi = crc ^ load_be32 (p);
+      uint32_t lo = load_be32 (p + 4);
+      crc = crc_table[7][hi >> 24] ^ crc_table[6][(hi >> 16) & 0xFF]
+            ^ crc_table[5][(hi >> 8) & 0xFF] ^ crc_table[4][hi & 0xFF]
+            ^ crc_table[3][lo >> 24] ^ crc_table[2][(lo >> 16) & 0xFF]
+            ^ crc_table[1][(lo >> 8) & 0xFF] ^ crc_table[0][lo & 0xFF];
+    }
+
+  while (len--)
+    crc = (crc << 8) ^ crc_table[0][(crc >> 24) ^ *p++];
+
+  return crc;
+}
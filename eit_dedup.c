@@ -0,0 +1,344 @@
+/*!
+  \file eit_dedup.c
+
+  MinHash/LSH Gruppierung für --dedup, siehe eit_dedup.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "eit_dedup.h"
+#include "eit_token.h"
+
+// Länge der MinHash Signatur, wird in DEDUP_HASHES / rows Bänder geteilt
+#define DEDUP_HASHES 128
+
+struct s_dedup_entry
+{
+  char *fn;
+  uint64_t *tokens;     // sortierte, eindeutige Hashes der Wörter
+  size_t num_tokens;
+  uint64_t sig[DEDUP_HASHES];
+};
+
+struct eit_dedup
+{
+  double threshold;
+  unsigned rows;        // Signaturwerte je Band
+
+  struct s_dedup_entry *entries;
+  size_t num_entries;
+  size_t max_entries;
+
+  uint64_t seeds[DEDUP_HASHES];
+
+  // Puffer für die Wörter der gerade hinzugefügten Datei
+  uint64_t *tmp;
+  size_t max_tmp;
+};
+
+// ein Band einer Datei, für die Suche nach gleichen Bändern sortiert
+struct s_band_key
+{
+  uint64_t key;
+  uint32_t band;
+  uint32_t idx;
+};
+
+// splitmix64, leitet aus einem Wert-Hash die DEDUP_HASHES unabhängigen Hashfunktionen ab
+static uint64_t mix64 (uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+struct eit_dedup *eit_dedup_new (double threshold)
+{
+  struct eit_dedup *d = calloc (1, sizeof (*d));
+  if (! d)
+    return NULL;
+  d->threshold = threshold;
+
+  /*
+    LSH findet ein Paar mit Ähnlichkeit s mit Wahrscheinlichkeit 1 - (1 - s^r)^b,
+    die Kurve steigt bei etwa (1/b)^(1/r). Die Bänder so wählen, dass dieser Punkt
+    deutlich unter threshold liegt, damit kaum echte Paare verloren gehen.
+  */
+  d->rows = 1;
+  for (unsigned r = 2; r <= 16; r *= 2)
+    {
+      double b = DEDUP_HASHES / r;
+      if (pow (1 / b, 1.0 / r) <= 0.85 * threshold)
+        d->rows = r;
+    }
+
+  uint64_t x = 0x5045495444454455ULL;
+  for (int k = 0; k < DEDUP_HASHES; ++k)
+    d->seeds[k] = x = mix64 (x);
+  return d;
+}
+
+static int cmp_u64 (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+// hängt die Hashes der Wörter von s an d->tmp an
+static int add_words (struct eit_dedup *d, size_t *num, const char *s)
+{
+  struct eit_token t;
+  eit_token_init (&t, s);
+  while (eit_token_next (&t))
+    {
+      if (*num == d->max_tmp)
+        {
+          size_t max = d->max_tmp ? 2 * d->max_tmp : 256;
+          uint64_t *tmp = realloc (d->tmp, max * sizeof (uint64_t));
+          if (! tmp)
+            return -1;
+          d->tmp = tmp;
+          d->max_tmp = max;
+        }
+      d->tmp[(*num)++] = eit_token_hash (t.word, t.len);
+    }
+  return 0;
+}
+
+int eit_dedup_add (struct eit_dedup *d, const char *fn, const struct eit_event *ev)
+{
+  size_t num = 0;
+  for (size_t k = 0; k < ev->num_short_events; ++k)
+    if (add_words (d, &num, ev->short_events[k].text))
+      return -1;
+  for (size_t k = 0; k < ev->num_extended_events; ++k)
+    if (add_words (d, &num, ev->extended_events[k].text))
+      return -1;
+
+  if (! num)
+    return 0;
+
+  qsort (d->tmp, num, sizeof (uint64_t), cmp_u64);
+  size_t n = 1;
+  for (size_t k = 1; k < num; ++k)
+    if (d->tmp[k] != d->tmp[n - 1])
+      d->tmp[n++] = d->tmp[k];
+
+  if (d->num_entries == d->max_entries)
+    {
+      size_t max = d->max_entries ? 2 * d->max_entries : 256;
+      struct s_dedup_entry *tmp = realloc (d->entries, max * sizeof (struct s_dedup_entry));
+      if (! tmp)
+        return -1;
+      d->entries = tmp;
+      d->max_entries = max;
+    }
+
+  struct s_dedup_entry *e = &d->entries[d->num_entries];
+  e->fn = strdup (fn);
+  e->tokens = malloc (n * sizeof (uint64_t));
+  if (! e->fn || ! e->tokens)
+    {
+      free (e->fn);
+      free (e->tokens);
+      return -1;
+    }
+  memcpy (e->tokens, d->tmp, n * sizeof (uint64_t));
+  e->num_tokens = n;
+
+  for (int j = 0; j < DEDUP_HASHES; ++j)
+    {
+      uint64_t m = UINT64_MAX;
+      for (size_t k = 0; k < n; ++k)
+        {
+          uint64_t h = mix64 (e->tokens[k] ^ d->seeds[j]);
+          if (h < m)
+            m = h;
+        }
+      e->sig[j] = m;
+    }
+
+  d->num_entries++;
+  return 0;
+}
+
+// genaue Jaccard Ähnlichkeit der beiden sortierten Wortmengen
+static double jaccard (const struct s_dedup_entry *a, const struct s_dedup_entry *b)
+{
+  size_t i = 0, j = 0, common = 0;
+  while (i < a->num_tokens && j < b->num_tokens)
+    {
+      if (a->tokens[i] == b->tokens[j])
+        {
+          common++;
+          i++;
+          j++;
+        }
+      else if (a->tokens[i] < b->tokens[j])
+        i++;
+      else
+        j++;
+    }
+  return (double) common / (a->num_tokens + b->num_tokens - common);
+}
+
+static size_t find_root (size_t *parent, size_t k)
+{
+  while (parent[k] != k)
+    {
+      parent[k] = parent[parent[k]];
+      k = parent[k];
+    }
+  return k;
+}
+
+// die kleinere Nummer wird Wurzel, damit ist die Wurzel die zuerst hinzugefügte Datei der Gruppe
+static void unite (size_t *parent, size_t a, size_t b)
+{
+  a = find_root (parent, a);
+  b = find_root (parent, b);
+  if (a < b)
+    parent[b] = a;
+  else if (b < a)
+    parent[a] = b;
+}
+
+static int cmp_band_key (const void *a, const void *b)
+{
+  const struct s_band_key *x = a;
+  const struct s_band_key *y = b;
+  if (x->band != y->band)
+    return (x->band > y->band) - (x->band < y->band);
+  if (x->key != y->key)
+    return (x->key > y->key) - (x->key < y->key);
+  return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+static void try_pair (struct eit_dedup *d, size_t *parent, size_t a, size_t b)
+{
+  if (find_root (parent, a) != find_root (parent, b)
+      && jaccard (&d->entries[a], &d->entries[b]) >= d->threshold)
+    unite (parent, a, b);
+}
+
+static void put_file (struct outbuf *out, const char *prefix, const char *fn, double similarity)
+{
+  char tmp[32];
+  outbuf_puts (out, prefix);
+  outbuf_puts (out, "{\"filename\":\"");
+  outbuf_put_json_escaped (out, fn);
+  snprintf (tmp, sizeof (tmp), "\",\"similarity\":%.2f}", similarity);
+  outbuf_puts (out, tmp);
+}
+
+int eit_dedup_write (struct eit_dedup *d, struct outbuf *out, char ndjson)
+{
+  size_t n = d->num_entries;
+  unsigned bands = DEDUP_HASHES / d->rows;
+
+  size_t *parent = malloc ((n + 1) * sizeof (size_t));
+  struct s_band_key *keys = malloc ((n * bands + 1) * sizeof (struct s_band_key));
+  if (! parent || ! keys)
+    {
+      free (parent);
+      free (keys);
+      return -1;
+    }
+  for (size_t k = 0; k < n; ++k)
+    parent[k] = k;
+
+  for (size_t k = 0; k < n; ++k)
+    for (unsigned b = 0; b < bands; ++b)
+      {
+        uint64_t h = b;
+        for (unsigned r = 0; r < d->rows; ++r)
+          h = mix64 (h ^ d->entries[k].sig[b * d->rows + r]);
+        struct s_band_key *bk = &keys[k * bands + b];
+        bk->key = h;
+        bk->band = b;
+        bk->idx = k;
+      }
+  qsort (keys, n * bands, sizeof (struct s_band_key), cmp_band_key);
+
+  // in einem Bucket jeden mit dem ersten und seinem Vorgänger vergleichen statt jedes Paar
+  for (size_t k = 0; k < n * bands; )
+    {
+      size_t end = k + 1;
+      while (end < n * bands && keys[end].band == keys[k].band && keys[end].key == keys[k].key)
+        end++;
+      for (size_t j = k + 1; j < end; ++j)
+        {
+          try_pair (d, parent, keys[k].idx, keys[j].idx);
+          if (j > k + 1)
+            try_pair (d, parent, keys[j - 1].idx, keys[j].idx);
+        }
+      k = end;
+    }
+  free (keys);
+
+  // Mitglieder je Gruppe: next verkettet die Dateien einer Wurzel in Reihenfolge
+  size_t *next = malloc ((n + 1) * sizeof (size_t));
+  size_t *last = malloc ((n + 1) * sizeof (size_t));
+  if (! next || ! last)
+    {
+      free (parent);
+      free (next);
+      free (last);
+      return -1;
+    }
+  for (size_t k = 0; k < n; ++k)
+    {
+      next[k] = SIZE_MAX;
+      size_t r = find_root (parent, k);
+      if (r != k)
+        {
+          next[last[r]] = k;
+          last[r] = k;
+        }
+      else
+        last[k] = k;
+    }
+
+  size_t num_groups = 0;
+  for (size_t k = 0; k < n; ++k)
+    {
+      if (parent[k] != k || next[k] == SIZE_MAX)
+        continue;
+
+      if (! ndjson)
+        outbuf_puts (out, num_groups ? ",\n " : "[\n ");
+      outbuf_puts (out, "{\"group\":");
+      outbuf_put_int (out, ++num_groups);
+      outbuf_puts (out, ",\"files\":[");
+      for (size_t j = k; j != SIZE_MAX; j = next[j])
+        put_file (out, (j == k)? "" : ",", d->entries[j].fn, jaccard (&d->entries[k], &d->entries[j]));
+      outbuf_puts (out, ndjson ? "]}\n" : "]}");
+    }
+  if (! ndjson)
+    outbuf_puts (out, num_groups ? "\n]\n" : "[]\n");
+
+  free (parent);
+  free (next);
+  free (last);
+  return 0;
+}
+
+void eit_dedup_free (struct eit_dedup *d)
+{
+  if (! d)
+    return;
+  for (size_t k = 0; k < d->num_entries; ++k)
+    {
+      free (d->entries[k].fn);
+      free (d->entries[k].tokens);
+    }
+  free (d->entries);
+  free (d->tmp);
+  free (d);
+}
@@ -0,0 +1,38 @@
+/*!
+  \file eit_dedup.h
+
+  --dedup: findet Aufnahmen derselben Sendung über die Wörter (eit_token.h)
+  des Textes und der extended_event_descriptor Texte, statt wie die Octave
+  Skripte in find_dup/ jedes Paar zu vergleichen.
+
+  Jede Datei bekommt eine MinHash Signatur, über LSH (die Signatur in Bänder
+  geteilt, je Band ein Hash) landen wahrscheinlich ähnliche Dateien im selben
+  Bucket. Nur diese Kandidaten werden mit der genauen Jaccard Ähnlichkeit der
+  Wortmengen verglichen, Paare über der Schwelle per union-find zu Gruppen
+  zusammengefasst.
+*/
+
+#ifndef EIT_DEDUP_H
+#define EIT_DEDUP_H
+
+#include "parse_eit.h"
+#include "outbuf.h"
+
+struct eit_dedup;
+
+// threshold: Jaccard Ähnlichkeit 0..1, ab der zwei Dateien als gleich gelten
+struct eit_dedup *eit_dedup_new (double threshold);
+
+// Wörter aller Texte von ev für fn merken, ohne Wörter zählt die Datei nicht. Rückgabe -1 bei Speichermangel
+int eit_dedup_add (struct eit_dedup *d, const char *fn, const struct eit_event *ev);
+
+/*
+  Schreibt alle Gruppen mit mindestens zwei Dateien nach out, geordnet nach
+  der zuerst hinzugefügten Datei. ndjson: ein Objekt pro Zeile, sonst ein
+  JSON Array. Rückgabe -1 bei Speichermangel.
+*/
+int eit_dedup_write (struct eit_dedup *d, struct outbuf *out, char ndjson);
+
+void eit_dedup_free (struct eit_dedup *d);
+
+#endif
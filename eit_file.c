@@ -0,0 +1,141 @@
+/*!
+  \file eit_file.c
+
+  Einlesen der .eit Dateien, siehe eit_file.h
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "eit_file.h"
+
+// bis zu dieser Größe ist ein read in den Puffer billiger als mmap + munmap
+#define MMAP_THRESHOLD (64 * 1024)
+
+void eit_file_init (struct eit_file *f)
+{
+  memset (f, 0, sizeof (*f));
+}
+
+static int reserve (struct eit_file *f, size_t size)
+{
+  if (size <= f->buf_size)
+    return 0;
+
+  size_t n = f->buf_size ? f->buf_size : 4096;
+  while (n < size)
+    n *= 2;
+
+  uint8_t *tmp = realloc (f->buf, n);
+  if (! tmp)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+  f->buf = tmp;
+  f->buf_size = n;
+  return 0;
+}
+
+// liest bis EOF, für Pipes und Dateien deren Größe sich geändert hat
+static int read_all (struct eit_file *f, int fd, size_t len)
+{
+  for (;;)
+    {
+      if (len == f->buf_size && reserve (f, len + 1))
+        return -1;
+
+      ssize_t r = read (fd, f->buf + len, f->buf_size - len);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r < 0)
+        return -1;
+      if (r == 0)
+        break;
+      len += r;
+    }
+  f->data = f->buf;
+  f->len = len;
+  return 0;
+}
+
+int eit_file_load (struct eit_file *f, const char *fn)
+{
+  eit_file_release (f);
+
+  int fd = open (fn, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+
+  int ret = 0;
+  struct stat st;
+  if (fstat (fd, &st) != 0)
+    ret = -1;
+  else if (S_ISREG (st.st_mode) && st.st_size > MMAP_THRESHOLD)
+    {
+      void *p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED)
+        {
+          f->map = p;
+          f->map_len = st.st_size;
+          f->data = p;
+          f->len = st.st_size;
+        }
+      else
+        ret = read_all (f, fd, 0);
+    }
+  else if (S_ISREG (st.st_mode))
+    {
+      // ein read mit der exakten Größe (+1, um gewachsene Dateien zu erkennen)
+      size_t size = st.st_size;
+      if (reserve (f, size + 1) == 0)
+        {
+          ssize_t r;
+          do
+            r = read (fd, f->buf, size + 1);
+          while (r < 0 && errno == EINTR);
+
+          if (r < 0)
+            ret = -1;
+          else if ((size_t) r == size + 1)
+            ret = read_all (f, fd, r);
+          else
+            {
+              f->data = f->buf;
+              f->len = r;
+            }
+        }
+      else
+        ret = -1;
+    }
+  else
+    ret = read_all (f, fd, 0);
+
+  int err = errno;
+  close (fd);
+  errno = err;
+  return ret;
+}
+
+void eit_file_release (struct eit_file *f)
+{
+  if (f->map)
+    munmap (f->map, f->map_len);
+  f->map = NULL;
+  f->map_len = 0;
+  f->data = NULL;
+  f->len = 0;
+}
+
+void eit_file_free (struct eit_file *f)
+{
+  eit_file_release (f);
+  free (f->buf);
+  eit_file_init (f);
+}
@@ -0,0 +1,36 @@
+/*!
+  \file eit_file.h
+
+  Einlesen der .eit Dateien für parse_eit: kleine Dateien mit einem read
+  in einen wiederverwendeten Puffer, große per mmap, beides ohne Größenlimit.
+*/
+
+#ifndef EIT_FILE_H
+#define EIT_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct eit_file
+{
+  const uint8_t *data;
+  size_t len;
+
+  // intern
+  void *map;
+  size_t map_len;
+  uint8_t *buf;       // über mehrere Dateien wiederverwendet
+  size_t buf_size;
+};
+
+void eit_file_init (struct eit_file *f);
+
+// öffnet und liest fn, Rückgabe -1 und errno bei Fehler
+int eit_file_load (struct eit_file *f, const char *fn);
+
+// gibt die Daten der zuletzt geladenen Datei frei (munmap), der Puffer bleibt
+void eit_file_release (struct eit_file *f);
+
+void eit_file_free (struct eit_file *f);
+
+#endif
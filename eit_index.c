@@ -0,0 +1,591 @@
+/*!
+  \file eit_index.c
+
+  Invertierter Index für --index und --query, Dateiformat siehe eit_index.h
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "eit_index.h"
+#include "eit_token.h"
+#include "outbuf.h"
+
+#define INDEX_MAGIC "PEITINDEX1\n"
+#define INDEX_BOM 0x01020304
+
+struct s_index_header
+{
+  char magic[12];
+  uint32_t bom;
+  uint32_t num_files;
+  uint32_t num_terms;
+  uint64_t files;
+  uint64_t terms;
+  uint64_t strings;
+  uint64_t postings;
+  uint32_t reserved[2];
+};
+
+struct s_index_term
+{
+  uint64_t str;
+  uint64_t post;
+  uint32_t str_len;
+  uint32_t num_files;
+  uint32_t post_len;
+  uint32_t reserved;
+};
+
+_Static_assert (sizeof (struct s_index_header) == 64, "index header must be 64 bytes");
+_Static_assert (sizeof (struct s_index_term) == 32, "index term must be 32 bytes");
+
+/*
+  Erzeugen
+*/
+
+// Eintrag der Hashtabelle, len == 0 = frei
+struct s_term
+{
+  uint64_t hash;
+  size_t word;        // Offset in pool
+  uint32_t len;
+  uint32_t num_ids;
+  uint32_t max_ids;
+  uint32_t *ids;
+};
+
+struct eit_index_writer
+{
+  struct s_term *terms;
+  size_t size;        // Zweierpotenz
+  size_t num_terms;
+
+  char *pool;         // die Wörter, null-terminiert
+  size_t pool_len;
+  size_t pool_size;
+
+  char **files;
+  size_t num_files;
+  size_t max_files;
+};
+
+struct eit_index_writer *eit_index_writer_new (void)
+{
+  struct eit_index_writer *w = calloc (1, sizeof (*w));
+  if (! w)
+    return NULL;
+  w->size = 4096;
+  w->terms = calloc (w->size, sizeof (struct s_term));
+  if (! w->terms)
+    {
+      free (w);
+      return NULL;
+    }
+  return w;
+}
+
+int eit_index_add_file (struct eit_index_writer *w, const char *fn)
+{
+  if (w->num_files == w->max_files)
+    {
+      size_t max = w->max_files ? 2 * w->max_files : 256;
+      char **tmp = realloc (w->files, max * sizeof (char *));
+      if (! tmp)
+        return -1;
+      w->files = tmp;
+      w->max_files = max;
+    }
+  w->files[w->num_files] = strdup (fn);
+  if (! w->files[w->num_files])
+    return -1;
+  w->num_files++;
+  return 0;
+}
+
+static int grow_table (struct eit_index_writer *w)
+{
+  size_t size = 2 * w->size;
+  struct s_term *terms = calloc (size, sizeof (struct s_term));
+  if (! terms)
+    return -1;
+  for (size_t k = 0; k < w->size; ++k)
+    if (w->terms[k].len)
+      {
+        size_t pos = w->terms[k].hash & (size - 1);
+        while (terms[pos].len)
+          pos = (pos + 1) & (size - 1);
+        terms[pos] = w->terms[k];
+      }
+  free (w->terms);
+  w->terms = terms;
+  w->size = size;
+  return 0;
+}
+
+static struct s_term *find_term (struct eit_index_writer *w, const char *word, size_t len)
+{
+  if (2 * (w->num_terms + 1) > w->size && grow_table (w))
+    return NULL;
+
+  uint64_t hash = eit_token_hash (word, len);
+  size_t pos = hash & (w->size - 1);
+  while (w->terms[pos].len)
+    {
+      struct s_term *t = &w->terms[pos];
+      if (t->hash == hash && t->len == len && ! memcmp (w->pool + t->word, word, len))
+        return t;
+      pos = (pos + 1) & (w->size - 1);
+    }
+
+  if (w->pool_size - w->pool_len < len + 1)
+    {
+      size_t size = w->pool_size ? 2 * w->pool_size : 65536;
+      char *tmp = realloc (w->pool, size);
+      if (! tmp)
+        return NULL;
+      w->pool = tmp;
+      w->pool_size = size;
+    }
+
+  struct s_term *t = &w->terms[pos];
+  t->hash = hash;
+  t->word = w->pool_len;
+  t->len = len;
+  memcpy (w->pool + w->pool_len, word, len);
+  w->pool[w->pool_len + len] = 0;
+  w->pool_len += len + 1;
+  w->num_terms++;
+  return t;
+}
+
+int eit_index_add_text (struct eit_index_writer *w, const char *text)
+{
+  if (! w->num_files)
+    return -1;
+  uint32_t id = w->num_files - 1;
+
+  struct eit_token tok;
+  eit_token_init (&tok, text);
+  while (eit_token_next (&tok))
+    {
+      struct s_term *t = find_term (w, tok.word, tok.len);
+      if (! t)
+        return -1;
+      // Dateien kommen nacheinander, damit sind die ids aufsteigend
+      if (t->num_ids && t->ids[t->num_ids - 1] == id)
+        continue;
+      if (t->num_ids == t->max_ids)
+        {
+          uint32_t max = t->max_ids ? 2 * t->max_ids : 4;
+          uint32_t *tmp = realloc (t->ids, max * sizeof (uint32_t));
+          if (! tmp)
+            return -1;
+          t->ids = tmp;
+          t->max_ids = max;
+        }
+      t->ids[t->num_ids++] = id;
+    }
+  return 0;
+}
+
+static const char *s_sort_pool = NULL;
+
+static int cmp_terms (const void *a, const void *b)
+{
+  const struct s_term *x = *(const struct s_term * const *) a;
+  const struct s_term *y = *(const struct s_term * const *) b;
+  int r = memcmp (s_sort_pool + x->word, s_sort_pool + y->word, (x->len < y->len)? x->len : y->len);
+  if (r)
+    return r;
+  return (x->len > y->len) - (x->len < y->len);
+}
+
+static void put_varint (struct outbuf *out, uint32_t v)
+{
+  while (v >= 0x80)
+    {
+      outbuf_putc (out, (v & 0x7F) | 0x80);
+      v >>= 7;
+    }
+  outbuf_putc (out, v);
+}
+
+// schreibt den fertig aufgebauten Index über fn.tmp nach fn
+static int write_file (const char *fn, const struct s_index_header *h, const uint64_t *files,
+                       const struct s_index_term *entries, struct s_term **sorted,
+                       const struct eit_index_writer *w, const struct outbuf *postings)
+{
+  char tmp_fn[strlen (fn) + 5];
+  snprintf (tmp_fn, sizeof (tmp_fn), "%s.tmp", fn);
+
+  FILE *f = fopen (tmp_fn, "wb");
+  if (! f)
+    return -1;
+
+  size_t n = h->num_terms;
+  int ok = fwrite (h, sizeof (*h), 1, f) == 1
+           && fwrite (files, sizeof (uint64_t), w->num_files, f) == w->num_files
+           && fwrite (entries, sizeof (struct s_index_term), n, f) == n;
+  for (size_t k = 0; k < n && ok; ++k)
+    ok = fwrite (w->pool + sorted[k]->word, 1, sorted[k]->len + 1, f) == sorted[k]->len + 1;
+  for (size_t k = 0; k < w->num_files && ok; ++k)
+    ok = fputs (w->files[k], f) >= 0 && fputc (0, f) != EOF;
+  if (ok && postings->len)
+    ok = fwrite (postings->data, 1, postings->len, f) == postings->len;
+
+  if (fclose (f) || ! ok || rename (tmp_fn, fn))
+    {
+      int e = errno;
+      unlink (tmp_fn);
+      errno = e;
+      return -1;
+    }
+  return 0;
+}
+
+int eit_index_write (struct eit_index_writer *w, const char *fn)
+{
+  struct s_term **sorted = malloc ((w->num_terms + 1) * sizeof (struct s_term *));
+  struct s_index_term *entries = calloc (w->num_terms + 1, sizeof (struct s_index_term));
+  uint64_t *files = malloc ((w->num_files + 1) * sizeof (uint64_t));
+  struct outbuf postings;
+  outbuf_init (&postings);
+
+  if (! sorted || ! entries || ! files)
+    {
+      free (sorted);
+      free (entries);
+      free (files);
+      errno = ENOMEM;
+      return -1;
+    }
+
+  size_t n = 0;
+  for (size_t k = 0; k < w->size; ++k)
+    if (w->terms[k].len)
+      sorted[n++] = &w->terms[k];
+  s_sort_pool = w->pool;
+  qsort (sorted, n, sizeof (struct s_term *), cmp_terms);
+
+  struct s_index_header h;
+  memset (&h, 0, sizeof (h));
+  memcpy (h.magic, INDEX_MAGIC, sizeof (INDEX_MAGIC));
+  h.bom = INDEX_BOM;
+  h.num_files = w->num_files;
+  h.num_terms = n;
+  h.files = sizeof (h);
+  h.terms = h.files + w->num_files * sizeof (uint64_t);
+  h.strings = h.terms + n * sizeof (struct s_index_term);
+
+  // strings: erst die Wörter in sortierter Reihenfolge, dann die Dateinamen
+  uint64_t str = h.strings;
+  for (size_t k = 0; k < n; ++k)
+    {
+      struct s_index_term *e = &entries[k];
+      e->str = str;
+      e->str_len = sorted[k]->len;
+      e->num_files = sorted[k]->num_ids;
+      str += sorted[k]->len + 1;
+
+      size_t start = postings.len;
+      uint32_t prev = 0;
+      for (uint32_t j = 0; j < sorted[k]->num_ids; ++j)
+        {
+          put_varint (&postings, sorted[k]->ids[j] - prev);
+          prev = sorted[k]->ids[j];
+        }
+      e->post = start;
+      e->post_len = postings.len - start;
+    }
+  for (size_t k = 0; k < w->num_files; ++k)
+    {
+      files[k] = str;
+      str += strlen (w->files[k]) + 1;
+    }
+  h.postings = str;
+  for (size_t k = 0; k < n; ++k)
+    entries[k].post += h.postings;
+
+  int ret;
+  if (postings.failed)
+    {
+      errno = ENOMEM;
+      ret = -1;
+    }
+  else
+    ret = write_file (fn, &h, files, entries, sorted, w, &postings);
+
+  free (sorted);
+  free (entries);
+  free (files);
+  outbuf_free (&postings);
+  return ret;
+}
+
+void eit_index_writer_free (struct eit_index_writer *w)
+{
+  if (! w)
+    return;
+  for (size_t k = 0; k < w->size; ++k)
+    free (w->terms[k].ids);
+  free (w->terms);
+  for (size_t k = 0; k < w->num_files; ++k)
+    free (w->files[k]);
+  free (w->files);
+  free (w->pool);
+  free (w);
+}
+
+/*
+  Lesen
+*/
+
+struct eit_index
+{
+  const uint8_t *data;
+  size_t size;
+  const struct s_index_header *h;
+  const uint64_t *files;
+  const struct s_index_term *terms;
+};
+
+struct eit_index *eit_index_open (const char *fn)
+{
+  int fd = open (fn, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat (fd, &st))
+    {
+      close (fd);
+      return NULL;
+    }
+  if ((size_t) st.st_size < sizeof (struct s_index_header))
+    {
+      close (fd);
+      errno = EINVAL;
+      return NULL;
+    }
+
+  void *map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  struct eit_index *ix = malloc (sizeof (*ix));
+  if (! ix)
+    {
+      munmap (map, st.st_size);
+      return NULL;
+    }
+  ix->data = map;
+  ix->size = st.st_size;
+  ix->h = map;
+
+  // die Tabellen müssen in der Datei liegen, die Einträge werden bei der Abfrage geprüft
+  const struct s_index_header *h = ix->h;
+  if (memcmp (h->magic, INDEX_MAGIC, sizeof (INDEX_MAGIC))
+      || h->bom != INDEX_BOM
+      || h->files != sizeof (*h)
+      || h->terms != h->files + (uint64_t) h->num_files * sizeof (uint64_t)
+      || h->strings != h->terms + (uint64_t) h->num_terms * sizeof (struct s_index_term)
+      || h->strings > ix->size || h->postings > ix->size || h->postings < h->strings)
+    {
+      eit_index_close (ix);
+      errno = EINVAL;
+      return NULL;
+    }
+  ix->files = (const uint64_t *) (ix->data + h->files);
+  ix->terms = (const struct s_index_term *) (ix->data + h->terms);
+  return ix;
+}
+
+static int valid_word (const struct eit_index *ix, const struct s_index_term *t)
+{
+  return t->str >= ix->h->strings && t->str <= ix->size && t->str_len <= ix->size - t->str;
+}
+
+// ungültige Einträge kommen hinter alle Wörter, damit endet die Suche dort
+static int cmp_word (const struct eit_index *ix, const struct s_index_term *t, const char *word, size_t len)
+{
+  if (! valid_word (ix, t))
+    return 1;
+  int r = memcmp (ix->data + t->str, word, (t->str_len < len)? t->str_len : len);
+  if (r)
+    return r;
+  return (t->str_len > len) - (t->str_len < len);
+}
+
+// erster Eintrag >= word
+static size_t lower_bound (const struct eit_index *ix, const char *word, size_t len)
+{
+  size_t lo = 0, hi = ix->h->num_terms;
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (cmp_word (ix, &ix->terms[mid], word, len) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+// hängt die Dateinummern von t an ids an, Rückgabe -1 bei kaputtem Eintrag
+static int decode_postings (const struct eit_index *ix, const struct s_index_term *t, uint32_t *ids, size_t *num)
+{
+  if (t->post < ix->h->postings || t->post > ix->size || t->post_len > ix->size - t->post
+      || t->num_files > ix->h->num_files)
+    return -1;
+
+  const uint8_t *p = ix->data + t->post;
+  const uint8_t *end = p + t->post_len;
+  uint64_t id = 0;
+  for (uint32_t k = 0; k < t->num_files; ++k)
+    {
+      uint64_t v = 0;
+      int shift = 0;
+      do
+        {
+          if (p == end || shift > 28)
+            return -1;
+          v |= (uint64_t) (*p & 0x7F) << shift;
+          shift += 7;
+        }
+      while (*p++ & 0x80);
+
+      id += v;
+      if (id >= ix->h->num_files)
+        return -1;
+      ids[(*num)++] = id;
+    }
+  return 0;
+}
+
+static int cmp_u32 (const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *) a;
+  uint32_t y = *(const uint32_t *) b;
+  return (x > y) - (x < y);
+}
+
+// Dateien mit einem Wort bzw. (prefix) einem Wort mit diesem Anfang, sortiert und eindeutig
+static long lookup (const struct eit_index *ix, const char *word, size_t len, char prefix, uint32_t **out)
+{
+  size_t k = lower_bound (ix, word, len);
+  size_t total = 0;
+  for (size_t j = k; j < ix->h->num_terms; ++j)
+    {
+      const struct s_index_term *t = &ix->terms[j];
+      if (prefix ? (! valid_word (ix, t) || t->str_len < len || memcmp (ix->data + t->str, word, len))
+          : cmp_word (ix, t, word, len) != 0)
+        break;
+      total += t->num_files;
+      if (! prefix)
+        break;
+    }
+
+  uint32_t *ids = malloc ((total + 1) * sizeof (uint32_t));
+  if (! ids)
+    return -1;
+
+  size_t num = 0;
+  for (size_t j = k; num < total; ++j)
+    if (decode_postings (ix, &ix->terms[j], ids, &num))
+      {
+        free (ids);
+        return -1;
+      }
+
+  if (prefix)
+    {
+      qsort (ids, num, sizeof (uint32_t), cmp_u32);
+      size_t n = 0;
+      for (size_t j = 0; j < num; ++j)
+        if (! n || ids[j] != ids[n - 1])
+          ids[n++] = ids[j];
+      num = n;
+    }
+  *out = ids;
+  return num;
+}
+
+long eit_index_query (const struct eit_index *ix, const char **terms, int num_terms, uint32_t **ids)
+{
+  uint32_t *result = NULL;
+  long num = 0;
+
+  for (int k = 0; k < num_terms; ++k)
+    {
+      size_t len = strlen (terms[k]);
+      char prefix = len && terms[k][len - 1] == '*';
+      if (prefix)
+        len--;
+
+      uint32_t *list;
+      long n = lookup (ix, terms[k], len, prefix, &list);
+      if (n < 0)
+        {
+          free (result);
+          return -1;
+        }
+
+      if (! k)
+        {
+          result = list;
+          num = n;
+        }
+      else
+        {
+          // beide Listen sind sortiert
+          long i = 0, j = 0, m = 0;
+          while (i < num && j < n)
+            {
+              if (result[i] == list[j])
+                {
+                  result[m++] = result[i];
+                  i++;
+                  j++;
+                }
+              else if (result[i] < list[j])
+                i++;
+              else
+                j++;
+            }
+          num = m;
+          free (list);
+        }
+      if (! num)
+        break;
+    }
+
+  *ids = result;
+  return num;
+}
+
+const char *eit_index_filename (const struct eit_index *ix, uint32_t id)
+{
+  if (id >= ix->h->num_files)
+    return NULL;
+  uint64_t off = ix->files[id];
+  if (off < ix->h->strings || off >= ix->h->postings || ! memchr (ix->data + off, 0, ix->h->postings - off))
+    return NULL;
+  return (const char *) ix->data + off;
+}
+
+void eit_index_close (struct eit_index *ix)
+{
+  if (! ix)
+    return;
+  munmap ((void *) ix->data, ix->size);
+  free (ix);
+}
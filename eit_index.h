@@ -0,0 +1,58 @@
+/*!
+  \file eit_index.h
+
+  --index OUT / --query INDEX: invertierter Index über event_name, text und
+  den extended text aller Dateien, Wörter wie bei --dedup (eit_token.h).
+
+  Dateiformat (native byte order wie beim Cache, alle Offsets ab Dateianfang):
+
+    Kopf, 64 Byte:
+      char magic[12] "PEITINDEX1\n", uint32_t 0x01020304, uint32_t num_files,
+      uint32_t num_terms, uint64_t files, uint64_t terms, uint64_t strings, uint64_t postings
+    files: num_files x uint64_t Offset des Dateinamens in strings
+    terms: num_terms x 32 Byte, nach Wort (memcmp) sortiert:
+      uint64_t Offset des Worts in strings, uint64_t Offset der Postings,
+      uint32_t Länge des Worts, uint32_t Anzahl Dateien, uint32_t Länge der Postings, uint32_t 0
+    strings: null-terminierte Wörter und Dateinamen
+    postings: je Wort die aufsteigenden Dateinummern als Differenz zur vorherigen
+      (die erste absolut), LEB128 varint
+
+  Gelesen wird per mmap, eine Abfrage braucht nur eine binäre Suche in terms
+  und das Dekodieren der betroffenen Postings.
+*/
+
+#ifndef EIT_INDEX_H
+#define EIT_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct eit_index_writer;
+struct eit_index;
+
+struct eit_index_writer *eit_index_writer_new (void);
+
+// alle folgenden Texte gehören zu fn, Rückgabe -1 bei Speichermangel
+int eit_index_add_file (struct eit_index_writer *w, const char *fn);
+int eit_index_add_text (struct eit_index_writer *w, const char *text);
+
+// schreibt den Index nach fn (über fn.tmp und rename), Rückgabe -1 und errno bei Fehler
+int eit_index_write (struct eit_index_writer *w, const char *fn);
+
+void eit_index_writer_free (struct eit_index_writer *w);
+
+// Rückgabe NULL und errno bei Fehler, EINVAL wenn fn kein gültiger Index ist
+struct eit_index *eit_index_open (const char *fn);
+
+/*
+  Dateinummern (aufsteigend, malloc) aller Dateien, die jedes der num_terms
+  Wörter enthalten. Ein Wort mit '*' am Ende passt auf alle Wörter mit diesem
+  Anfang. Rückgabe Anzahl der Dateien oder -1 bei Speichermangel bzw. kaputtem Index.
+*/
+long eit_index_query (const struct eit_index *ix, const char **terms, int num_terms, uint32_t **ids);
+
+const char *eit_index_filename (const struct eit_index *ix, uint32_t id);
+
+void eit_index_close (struct eit_index *ix);
+
+#endif
@@ -0,0 +1,44 @@
+/*!
+  \file eit_internal.h
+
+  Gemeinsame Funktionen der libparse_eit Module, nicht Teil der öffentlichen API
+*/
+
+#ifndef EIT_INTERNAL_H
+#define EIT_INTERNAL_H
+
+#include "parse_eit.h"
+
+// eit_arena.c
+
+// gibt alle Strings frei, hint = benötigte Größe für die nächste Datei
+int eit_arena_reset (struct eit_ctx *ctx, size_t hint);
+void eit_arena_free (struct eit_ctx *ctx);
+
+// Speicher, der beim nächsten eit_parse bzw. eit_ctx_free freigegeben wird
+void *eit_alloc (struct eit_ctx *ctx, size_t size);
+
+// gibt den nicht benötigten Rest der letzten Allokation zurück
+void eit_arena_shrink (struct eit_ctx *ctx, void *p, size_t old_size, size_t new_size);
+
+// eit_parse.c
+
+int eit_set_error (struct eit_ctx *ctx, int err, const char *fmt, ...)
+__attribute__ ((format (printf, 3, 4)));
+
+uint8_t parse_duration (const uint8_t *p, size_t len, struct eit_duration *s);
+uint8_t parse_start_time (const uint8_t *p, size_t len, struct eit_start_time *s);
+
+// eit_text.c
+
+size_t get_code_table (const uint8_t *p, size_t len, const char **code_table);
+
+/*
+  Dekodiert ein Textfeld (Annex A) nach UTF-8, *out zeigt danach auf einen
+  null-terminierten String aus eit_alloc.
+*/
+int eit_decode_text (struct eit_ctx *ctx, const uint8_t *p, size_t len, char **out);
+
+void eit_close_iconv_cache (struct eit_ctx *ctx);
+
+#endif
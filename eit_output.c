@@ -0,0 +1,781 @@
+/*!
+  \file eit_output.c
+
+  Ausgabeformate von parse_eit, siehe eit_output.h
+
+  ndjson und bin haben dieselben Schlüssel wie json, short/extended event
+  descriptors stehen aber als Arrays in "short_events" bzw. "extended_events"
+  statt in durchnummerierten bzw. mehrfach vorkommenden Schlüsseln, und es gibt
+  keinen "empty_structure" Block.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "eit_output.h"
+
+int output_format_from_name (const char *name)
+{
+  if (! strcmp (name, "json"))
+    return OUTPUT_JSON;
+  if (! strcmp (name, "ndjson"))
+    return OUTPUT_NDJSON;
+  if (! strcmp (name, "bin"))
+    return OUTPUT_BIN;
+  return -1;
+}
+
+int output_fields_from_list (const char *list)
+{
+  static const struct
+  {
+    const char *name;
+    unsigned field;
+  } names[] =
+  {
+    {"event_id", EIT_FIELD_EVENT_ID},
+    {"start_time", EIT_FIELD_START_TIME},
+    {"duration", EIT_FIELD_DURATION},
+    {"running_status", EIT_FIELD_RUNNING_STATUS},
+    {"free_CA_mode", EIT_FIELD_FREE_CA_MODE},
+    {"event_name", EIT_FIELD_EVENT_NAME},
+    {"text", EIT_FIELD_TEXT},
+    {"extended", EIT_FIELD_EXTENDED},
+    {"component", EIT_FIELD_COMPONENT},
+    {"content", EIT_FIELD_CONTENT},
+    {"parental_rating", EIT_FIELD_PARENTAL_RATING}
+  };
+
+  int fields = 0;
+  while (*list)
+    {
+      size_t len = strcspn (list, ",");
+      size_t k = 0;
+      while (k < sizeof (names) / sizeof (names[0])
+             && (strlen (names[k].name) != len || strncmp (names[k].name, list, len)))
+        k++;
+      if (k == sizeof (names) / sizeof (names[0]))
+        return -1;
+
+      fields |= names[k].field;
+      list += len;
+      if (*list == ',')
+        list++;
+    }
+  return fields;
+}
+
+static void put_start_time (struct outbuf *out, const struct eit_start_time *st)
+{
+  outbuf_put_int (out, st->Y);
+  outbuf_putc (out, '/');
+  outbuf_put_int (out, st->M);
+  outbuf_putc (out, '/');
+  outbuf_put_int (out, st->D);
+  outbuf_putc (out, ' ');
+  outbuf_put_int02 (out, st->t.hour);
+  outbuf_putc (out, ':');
+  outbuf_put_int02 (out, st->t.minute);
+  outbuf_putc (out, ':');
+  outbuf_put_int02 (out, st->t.second);
+}
+
+static void put_duration (struct outbuf *out, const struct eit_duration *dur)
+{
+  outbuf_put_int02 (out, dur->hour);
+  outbuf_putc (out, ':');
+  outbuf_put_int02 (out, dur->minute);
+  outbuf_putc (out, ':');
+  outbuf_put_int02 (out, dur->second);
+}
+
+/*
+  --format=json
+*/
+
+// "key": "wert"<suffix> mit escaptem wert
+static void put_string_field (struct outbuf *out, const char *key, const char *value, const char *suffix)
+{
+  outbuf_puts (out, key);
+  outbuf_put_json_escaped (out, value);
+  outbuf_puts (out, suffix);
+}
+
+// Felder aus dem Kopf einer section, gleiche Reihenfolge in allen Formaten
+#define NUM_SECTION_FIELDS 6
+
+static void get_section_fields (const struct eit_section *sec, const char **keys, long *values)
+{
+  keys[0] = "table_id";
+  values[0] = sec->table_id;
+  keys[1] = "service_id";
+  values[1] = sec->service_id;
+  keys[2] = "transport_stream_id";
+  values[2] = sec->transport_stream_id;
+  keys[3] = "original_network_id";
+  values[3] = sec->original_network_id;
+  keys[4] = "version_number";
+  values[4] = sec->version_number;
+  keys[5] = "section_number";
+  values[5] = sec->section_number;
+}
+
+void output_json_head (struct outbuf *out, const char *fn, const struct eit_section *sec)
+{
+  // print opening bracket
+  outbuf_puts (out, " {\n");
+
+  put_string_field (out, "  \"filename\": \"", fn, "\",\n");
+
+  if (sec)
+    {
+      const char *keys[NUM_SECTION_FIELDS];
+      long values[NUM_SECTION_FIELDS];
+      get_section_fields (sec, keys, values);
+      for (int k = 0; k < NUM_SECTION_FIELDS; ++k)
+        {
+          outbuf_puts (out, "  \"");
+          outbuf_puts (out, keys[k]);
+          outbuf_puts (out, "\": ");
+          outbuf_put_int (out, values[k]);
+          outbuf_puts (out, ",\n");
+        }
+    }
+}
+
+// 6.2.28: 0x01..0x0F Mindestalter rating + 3, sonst 0 (undefiniert bzw. vom Sender festgelegt)
+static int min_age (uint8_t rating)
+{
+  return (rating >= 0x01 && rating <= 0x0F)? rating + 3 : 0;
+}
+
+static void print_event (struct outbuf *out, unsigned fields, const struct eit_event *ev)
+{
+  if (fields & EIT_FIELD_EVENT_ID)
+    {
+      outbuf_puts (out, "  \"event_id\": ");
+      outbuf_put_int (out, ev->event_id);
+      outbuf_puts (out, ",\n");
+    }
+  if (fields & EIT_FIELD_START_TIME && ev->start_time.undefined)
+    outbuf_puts (out, "  \"start_time\": null,\n  \"start_time_unix\": null,\n");
+  else if (fields & EIT_FIELD_START_TIME)
+    {
+      outbuf_puts (out, "  \"start_time\": \"");
+      put_start_time (out, &ev->start_time);
+      outbuf_puts (out, "\",\n  \"start_time_unix\": ");
+      outbuf_put_int (out, ev->start_time.unix_time);
+      outbuf_puts (out, ",\n");
+    }
+  if (fields & EIT_FIELD_DURATION)
+    {
+      outbuf_puts (out, "  \"duration\": \"");
+      put_duration (out, &ev->duration);
+      outbuf_puts (out, "\",\n");
+    }
+  if (fields & EIT_FIELD_RUNNING_STATUS)
+    {
+      outbuf_puts (out, "  \"running_status\": ");
+      outbuf_put_int (out, ev->running_status);
+      outbuf_puts (out, ",\n");
+    }
+  if (fields & EIT_FIELD_FREE_CA_MODE)
+    {
+      outbuf_puts (out, "  \"free_CA_mode\": ");
+      outbuf_put_int (out, ev->free_CA_mode);
+      outbuf_puts (out, ",\n");
+    }
+
+  // geargineer: counter fuer die short events eingefuehrt, um diese im json unterscheiden zu koennen
+  for (size_t k = 0; k < ev->num_short_events; ++k)
+    {
+      const struct eit_short_event *se = &ev->short_events[k];
+      outbuf_puts (out, "  \"short_event_descriptor_");
+      outbuf_put_int (out, k + 1);
+      outbuf_puts (out, "\":\n  {\n");
+      put_string_field (out, "    \"iso_639_2_language_code\": \"", se->language, "\"");
+      if (fields & EIT_FIELD_EVENT_NAME)
+        put_string_field (out, ",\n    \"event_name\": \"", se->event_name, "\"");
+      if (fields & EIT_FIELD_TEXT)
+        put_string_field (out, ",\n    \"text\": \"", se->text, "\"");
+      outbuf_puts (out, "\n  },\n");
+    }
+
+  for (size_t k = 0; k < ev->num_extended_events; ++k)
+    {
+      const struct eit_extended_event *ee = &ev->extended_events[k];
+      outbuf_puts (out, "  \"extended_event_descriptor\":\n  {\n");
+      put_string_field (out, "    \"iso_639_2_language_code\": \"", ee->language, "\",\n");
+      // IWi 20251107: um den text im extended descriptor zu identifizieren den key von 'text' auf 'text_extended' gesetzt
+      // printf ("    \"text_extended\": \"");
+      // geargineer 20251120 added comma to terminate json-structure before next structure
+      put_string_field (out, "    \"text\": \"", ee->text, "\"");
+      if (ee->num_items)
+        {
+          outbuf_puts (out, ",\n    \"items\":\n    [\n");
+          for (size_t i = 0; i < ee->num_items; ++i)
+            {
+              put_string_field (out, "      {\"description\": \"", ee->items[i].description, "\", ");
+              put_string_field (out, "\"item\": \"", ee->items[i].item, (i < ee->num_items - 1)? "\"},\n" : "\"}\n");
+            }
+          outbuf_puts (out, "    ]");
+        }
+      outbuf_puts (out, "\n  },\n");
+    }
+
+  // je ein Objekt pro Zeile wie bei den items, nur wenn vorhanden
+  if (ev->num_components)
+    {
+      outbuf_puts (out, "  \"components\":\n  [\n");
+      for (size_t k = 0; k < ev->num_components; ++k)
+        {
+          const struct eit_component *c = &ev->components[k];
+          outbuf_puts (out, "    {\"stream_content_ext\": ");
+          outbuf_put_int (out, c->stream_content_ext);
+          outbuf_puts (out, ", \"stream_content\": ");
+          outbuf_put_int (out, c->stream_content);
+          outbuf_puts (out, ", \"component_type\": ");
+          outbuf_put_int (out, c->component_type);
+          outbuf_puts (out, ", \"component_tag\": ");
+          outbuf_put_int (out, c->component_tag);
+          put_string_field (out, ", \"iso_639_2_language_code\": \"", c->language, "\", ");
+          put_string_field (out, "\"text\": \"", c->text, (k < ev->num_components - 1)? "\"},\n" : "\"}\n");
+        }
+      outbuf_puts (out, "  ],\n");
+    }
+
+  if (ev->num_contents)
+    {
+      outbuf_puts (out, "  \"contents\":\n  [\n");
+      for (size_t k = 0; k < ev->num_contents; ++k)
+        {
+          const struct eit_content *c = &ev->contents[k];
+          outbuf_puts (out, "    {\"level_1\": ");
+          outbuf_put_int (out, c->level_1);
+          outbuf_puts (out, ", \"level_2\": ");
+          outbuf_put_int (out, c->level_2);
+          put_string_field (out, ", \"genre\": \"", eit_content_genre (c->level_1), "\", ");
+          outbuf_puts (out, "\"user_byte\": ");
+          outbuf_put_int (out, c->user_byte);
+          outbuf_puts (out, (k < ev->num_contents - 1)? "},\n" : "}\n");
+        }
+      outbuf_puts (out, "  ],\n");
+    }
+
+  if (ev->num_parental_ratings)
+    {
+      outbuf_puts (out, "  \"parental_ratings\":\n  [\n");
+      for (size_t k = 0; k < ev->num_parental_ratings; ++k)
+        {
+          const struct eit_parental_rating *r = &ev->parental_ratings[k];
+          put_string_field (out, "    {\"country_code\": \"", r->country, "\", ");
+          outbuf_puts (out, "\"rating\": ");
+          outbuf_put_int (out, r->rating);
+          outbuf_puts (out, ", \"min_age\": ");
+          if (min_age (r->rating))
+            outbuf_put_int (out, min_age (r->rating));
+          else
+            outbuf_puts (out, "null");
+          outbuf_puts (out, (k < ev->num_parental_ratings - 1)? "},\n" : "}\n");
+        }
+      outbuf_puts (out, "  ],\n");
+    }
+}
+
+static void output_json (struct outbuf *out, unsigned fields, const struct eit_event *ev, const char *errmsg)
+{
+  if (ev)
+    print_event (out, fields, ev);
+
+  if (errmsg)
+    put_string_field (out, "  \"error\": \"", errmsg, "\",\n");
+
+  // regular termination of program:
+  outbuf_puts (out, "  \"empty_structure\":\n"
+               "  {\n"
+               "    \"dummy\": \"nix\" \n"
+               "  }\n");
+
+  // print closing bracket for valid json
+  outbuf_puts (out, " }");
+}
+
+/*
+  --format=ndjson
+*/
+
+static void put_ndjson_string (struct outbuf *out, const char *key, const char *value)
+{
+  outbuf_puts (out, key);
+  outbuf_putc (out, '"');
+  outbuf_put_json_escaped (out, value);
+  outbuf_putc (out, '"');
+}
+
+static void output_ndjson (struct outbuf *out, unsigned fields, const char *fn, const struct eit_section *sec,
+                           const struct eit_event *ev, const char *errmsg)
+{
+  if (! ev)
+    fields = 0;
+
+  put_ndjson_string (out, "{\"filename\":", fn);
+
+  if (sec)
+    {
+      const char *keys[NUM_SECTION_FIELDS];
+      long values[NUM_SECTION_FIELDS];
+      get_section_fields (sec, keys, values);
+      for (int k = 0; k < NUM_SECTION_FIELDS; ++k)
+        {
+          outbuf_puts (out, ",\"");
+          outbuf_puts (out, keys[k]);
+          outbuf_puts (out, "\":");
+          outbuf_put_int (out, values[k]);
+        }
+    }
+
+  if (fields & EIT_FIELD_EVENT_ID)
+    {
+      outbuf_puts (out, ",\"event_id\":");
+      outbuf_put_int (out, ev->event_id);
+    }
+  if (fields & EIT_FIELD_START_TIME && ev->start_time.undefined)
+    outbuf_puts (out, ",\"start_time\":null,\"start_time_unix\":null");
+  else if (fields & EIT_FIELD_START_TIME)
+    {
+      outbuf_puts (out, ",\"start_time\":\"");
+      put_start_time (out, &ev->start_time);
+      outbuf_puts (out, "\",\"start_time_unix\":");
+      outbuf_put_int (out, ev->start_time.unix_time);
+    }
+  if (fields & EIT_FIELD_DURATION)
+    {
+      outbuf_puts (out, ",\"duration\":\"");
+      put_duration (out, &ev->duration);
+      outbuf_putc (out, '"');
+    }
+  if (fields & EIT_FIELD_RUNNING_STATUS)
+    {
+      outbuf_puts (out, ",\"running_status\":");
+      outbuf_put_int (out, ev->running_status);
+    }
+  if (fields & EIT_FIELD_FREE_CA_MODE)
+    {
+      outbuf_puts (out, ",\"free_CA_mode\":");
+      outbuf_put_int (out, ev->free_CA_mode);
+    }
+
+  if (fields & (EIT_FIELD_EVENT_NAME | EIT_FIELD_TEXT))
+    {
+      outbuf_puts (out, ",\"short_events\":[");
+      for (size_t k = 0; k < ev->num_short_events; ++k)
+        {
+          const struct eit_short_event *se = &ev->short_events[k];
+          if (k)
+            outbuf_putc (out, ',');
+          put_ndjson_string (out, "{\"iso_639_2_language_code\":", se->language);
+          if (fields & EIT_FIELD_EVENT_NAME)
+            put_ndjson_string (out, ",\"event_name\":", se->event_name);
+          if (fields & EIT_FIELD_TEXT)
+            put_ndjson_string (out, ",\"text\":", se->text);
+          outbuf_putc (out, '}');
+        }
+      outbuf_putc (out, ']');
+    }
+
+  if (fields & EIT_FIELD_EXTENDED)
+    {
+      outbuf_puts (out, ",\"extended_events\":[");
+      for (size_t k = 0; k < ev->num_extended_events; ++k)
+        {
+          const struct eit_extended_event *ee = &ev->extended_events[k];
+          if (k)
+            outbuf_putc (out, ',');
+          put_ndjson_string (out, "{\"iso_639_2_language_code\":", ee->language);
+          put_ndjson_string (out, ",\"text\":", ee->text);
+          outbuf_puts (out, ",\"items\":[");
+          for (size_t i = 0; i < ee->num_items; ++i)
+            {
+              put_ndjson_string (out, i ? ",{\"description\":" : "{\"description\":", ee->items[i].description);
+              put_ndjson_string (out, ",\"item\":", ee->items[i].item);
+              outbuf_putc (out, '}');
+            }
+          outbuf_puts (out, "]}");
+        }
+      outbuf_putc (out, ']');
+    }
+
+  if (fields & EIT_FIELD_COMPONENT)
+    {
+      outbuf_puts (out, ",\"components\":[");
+      for (size_t k = 0; k < ev->num_components; ++k)
+        {
+          const struct eit_component *c = &ev->components[k];
+          outbuf_puts (out, k ? ",{\"stream_content_ext\":" : "{\"stream_content_ext\":");
+          outbuf_put_int (out, c->stream_content_ext);
+          outbuf_puts (out, ",\"stream_content\":");
+          outbuf_put_int (out, c->stream_content);
+          outbuf_puts (out, ",\"component_type\":");
+          outbuf_put_int (out, c->component_type);
+          outbuf_puts (out, ",\"component_tag\":");
+          outbuf_put_int (out, c->component_tag);
+          put_ndjson_string (out, ",\"iso_639_2_language_code\":", c->language);
+          put_ndjson_string (out, ",\"text\":", c->text);
+          outbuf_putc (out, '}');
+        }
+      outbuf_putc (out, ']');
+    }
+
+  if (fields & EIT_FIELD_CONTENT)
+    {
+      outbuf_puts (out, ",\"contents\":[");
+      for (size_t k = 0; k < ev->num_contents; ++k)
+        {
+          const struct eit_content *c = &ev->contents[k];
+          outbuf_puts (out, k ? ",{\"level_1\":" : "{\"level_1\":");
+          outbuf_put_int (out, c->level_1);
+          outbuf_puts (out, ",\"level_2\":");
+          outbuf_put_int (out, c->level_2);
+          put_ndjson_string (out, ",\"genre\":", eit_content_genre (c->level_1));
+          outbuf_puts (out, ",\"user_byte\":");
+          outbuf_put_int (out, c->user_byte);
+          outbuf_putc (out, '}');
+        }
+      outbuf_putc (out, ']');
+    }
+
+  if (fields & EIT_FIELD_PARENTAL_RATING)
+    {
+      outbuf_puts (out, ",\"parental_ratings\":[");
+      for (size_t k = 0; k < ev->num_parental_ratings; ++k)
+        {
+          const struct eit_parental_rating *r = &ev->parental_ratings[k];
+          put_ndjson_string (out, k ? ",{\"country_code\":" : "{\"country_code\":", r->country);
+          outbuf_puts (out, ",\"rating\":");
+          outbuf_put_int (out, r->rating);
+          outbuf_puts (out, ",\"min_age\":");
+          if (min_age (r->rating))
+            outbuf_put_int (out, min_age (r->rating));
+          else
+            outbuf_puts (out, "null");
+          outbuf_putc (out, '}');
+        }
+      outbuf_putc (out, ']');
+    }
+
+  if (errmsg)
+    put_ndjson_string (out, ",\"error\":", errmsg);
+  outbuf_puts (out, "}\n");
+}
+
+/*
+  --format=bin, MessagePack (https://github.com/msgpack/msgpack/blob/master/spec.md)
+*/
+
+static void put_be (struct outbuf *out, uint64_t v, int bytes)
+{
+  char b[8];
+  for (int k = 0; k < bytes; ++k)
+    b[k] = v >> (8 * (bytes - 1 - k));
+  outbuf_put (out, b, bytes);
+}
+
+static void mp_uint (struct outbuf *out, uint64_t v)
+{
+  if (v < 0x80)
+    outbuf_putc (out, v);
+  else if (v <= 0xFF)
+    {
+      outbuf_putc (out, 0xcc);
+      put_be (out, v, 1);
+    }
+  else if (v <= 0xFFFF)
+    {
+      outbuf_putc (out, 0xcd);
+      put_be (out, v, 2);
+    }
+  else if (v <= 0xFFFFFFFF)
+    {
+      outbuf_putc (out, 0xce);
+      put_be (out, v, 4);
+    }
+  else
+    {
+      outbuf_putc (out, 0xcf);
+      put_be (out, v, 8);
+    }
+}
+
+static void mp_int (struct outbuf *out, int64_t v)
+{
+  if (v >= 0)
+    mp_uint (out, v);
+  else if (v >= -32)
+    outbuf_putc (out, v);
+  else
+    {
+      outbuf_putc (out, 0xd3);
+      put_be (out, v, 8);
+    }
+}
+
+static void mp_nil (struct outbuf *out)
+{
+  outbuf_putc (out, 0xc0);
+}
+
+static void mp_header (struct outbuf *out, size_t n, uint8_t fix, size_t fix_max, uint8_t tag16)
+{
+  if (n <= fix_max)
+    outbuf_putc (out, fix | n);
+  else if (n <= 0xFFFF)
+    {
+      outbuf_putc (out, tag16);
+      put_be (out, n, 2);
+    }
+  else
+    {
+      outbuf_putc (out, tag16 + 1);
+      put_be (out, n, 4);
+    }
+}
+
+static void mp_str (struct outbuf *out, const char *s)
+{
+  size_t len = strlen (s);
+  if (len > 31 && len <= 0xFF)
+    {
+      outbuf_putc (out, 0xd9);
+      put_be (out, len, 1);
+    }
+  else
+    mp_header (out, len, 0xa0, 31, 0xda);
+  outbuf_put (out, s, len);
+}
+
+static void mp_map (struct outbuf *out, size_t n)
+{
+  mp_header (out, n, 0x80, 15, 0xde);
+}
+
+static void mp_array (struct outbuf *out, size_t n)
+{
+  mp_header (out, n, 0x90, 15, 0xdc);
+}
+
+static void output_bin (struct outbuf *out, unsigned fields, const char *fn, const struct eit_section *sec,
+                        const struct eit_event *ev, const char *errmsg)
+{
+  if (! ev)
+    fields = 0;
+
+  // Länge wird am Ende eingetragen
+  size_t start = out->len;
+  put_be (out, 0, 4);
+
+  char short_events = (fields & (EIT_FIELD_EVENT_NAME | EIT_FIELD_TEXT)) != 0;
+  char extended_events = (fields & EIT_FIELD_EXTENDED) != 0;
+  // start_time kommt mit start_time_unix
+  mp_map (out, 1 + __builtin_popcount (fields & (EIT_FIELD_EVENT_ID | EIT_FIELD_START_TIME | EIT_FIELD_DURATION
+                                                 | EIT_FIELD_RUNNING_STATUS | EIT_FIELD_FREE_CA_MODE
+                                                 | EIT_FIELD_COMPONENT | EIT_FIELD_CONTENT | EIT_FIELD_PARENTAL_RATING))
+          + ((fields & EIT_FIELD_START_TIME) != 0) + short_events + extended_events + (errmsg != NULL) + (sec ? NUM_SECTION_FIELDS : 0));
+
+  mp_str (out, "filename");
+  mp_str (out, fn);
+
+  if (sec)
+    {
+      const char *keys[NUM_SECTION_FIELDS];
+      long values[NUM_SECTION_FIELDS];
+      get_section_fields (sec, keys, values);
+      for (int k = 0; k < NUM_SECTION_FIELDS; ++k)
+        {
+          mp_str (out, keys[k]);
+          mp_uint (out, values[k]);
+        }
+    }
+  if (fields & EIT_FIELD_EVENT_ID)
+    {
+      mp_str (out, "event_id");
+      mp_uint (out, ev->event_id);
+    }
+
+  // gleiche Textdarstellung wie bei json
+  char tmp[64];
+  if (fields & EIT_FIELD_START_TIME && ev->start_time.undefined)
+    {
+      mp_str (out, "start_time");
+      mp_nil (out);
+      mp_str (out, "start_time_unix");
+      mp_nil (out);
+    }
+  else if (fields & EIT_FIELD_START_TIME)
+    {
+      const struct eit_start_time *st = &ev->start_time;
+      snprintf (tmp, sizeof (tmp), "%i/%i/%i %02i:%02i:%02i",
+                st->Y, st->M, st->D, st->t.hour, st->t.minute, st->t.second);
+      mp_str (out, "start_time");
+      mp_str (out, tmp);
+      mp_str (out, "start_time_unix");
+      mp_int (out, st->unix_time);
+    }
+  if (fields & EIT_FIELD_DURATION)
+    {
+      snprintf (tmp, sizeof (tmp), "%02i:%02i:%02i",
+                ev->duration.hour, ev->duration.minute, ev->duration.second);
+      mp_str (out, "duration");
+      mp_str (out, tmp);
+    }
+  if (fields & EIT_FIELD_RUNNING_STATUS)
+    {
+      mp_str (out, "running_status");
+      mp_uint (out, ev->running_status);
+    }
+  if (fields & EIT_FIELD_FREE_CA_MODE)
+    {
+      mp_str (out, "free_CA_mode");
+      mp_uint (out, ev->free_CA_mode);
+    }
+
+  if (short_events)
+    {
+      mp_str (out, "short_events");
+      mp_array (out, ev->num_short_events);
+      for (size_t k = 0; k < ev->num_short_events; ++k)
+        {
+          const struct eit_short_event *se = &ev->short_events[k];
+          mp_map (out, 1 + ((fields & EIT_FIELD_EVENT_NAME) != 0) + ((fields & EIT_FIELD_TEXT) != 0));
+          mp_str (out, "iso_639_2_language_code");
+          mp_str (out, se->language);
+          if (fields & EIT_FIELD_EVENT_NAME)
+            {
+              mp_str (out, "event_name");
+              mp_str (out, se->event_name);
+            }
+          if (fields & EIT_FIELD_TEXT)
+            {
+              mp_str (out, "text");
+              mp_str (out, se->text);
+            }
+        }
+    }
+
+  if (extended_events)
+    {
+      mp_str (out, "extended_events");
+      mp_array (out, ev->num_extended_events);
+      for (size_t k = 0; k < ev->num_extended_events; ++k)
+        {
+          const struct eit_extended_event *ee = &ev->extended_events[k];
+          mp_map (out, 3);
+          mp_str (out, "iso_639_2_language_code");
+          mp_str (out, ee->language);
+          mp_str (out, "text");
+          mp_str (out, ee->text);
+          mp_str (out, "items");
+          mp_array (out, ee->num_items);
+          for (size_t i = 0; i < ee->num_items; ++i)
+            {
+              mp_map (out, 2);
+              mp_str (out, "description");
+              mp_str (out, ee->items[i].description);
+              mp_str (out, "item");
+              mp_str (out, ee->items[i].item);
+            }
+        }
+    }
+
+  if (fields & EIT_FIELD_COMPONENT)
+    {
+      mp_str (out, "components");
+      mp_array (out, ev->num_components);
+      for (size_t k = 0; k < ev->num_components; ++k)
+        {
+          const struct eit_component *c = &ev->components[k];
+          mp_map (out, 6);
+          mp_str (out, "stream_content_ext");
+          mp_uint (out, c->stream_content_ext);
+          mp_str (out, "stream_content");
+          mp_uint (out, c->stream_content);
+          mp_str (out, "component_type");
+          mp_uint (out, c->component_type);
+          mp_str (out, "component_tag");
+          mp_uint (out, c->component_tag);
+          mp_str (out, "iso_639_2_language_code");
+          mp_str (out, c->language);
+          mp_str (out, "text");
+          mp_str (out, c->text);
+        }
+    }
+
+  if (fields & EIT_FIELD_CONTENT)
+    {
+      mp_str (out, "contents");
+      mp_array (out, ev->num_contents);
+      for (size_t k = 0; k < ev->num_contents; ++k)
+        {
+          const struct eit_content *c = &ev->contents[k];
+          mp_map (out, 4);
+          mp_str (out, "level_1");
+          mp_uint (out, c->level_1);
+          mp_str (out, "level_2");
+          mp_uint (out, c->level_2);
+          mp_str (out, "genre");
+          mp_str (out, eit_content_genre (c->level_1));
+          mp_str (out, "user_byte");
+          mp_uint (out, c->user_byte);
+        }
+    }
+
+  if (fields & EIT_FIELD_PARENTAL_RATING)
+    {
+      mp_str (out, "parental_ratings");
+      mp_array (out, ev->num_parental_ratings);
+      for (size_t k = 0; k < ev->num_parental_ratings; ++k)
+        {
+          const struct eit_parental_rating *r = &ev->parental_ratings[k];
+          mp_map (out, 3);
+          mp_str (out, "country_code");
+          mp_str (out, r->country);
+          mp_str (out, "rating");
+          mp_uint (out, r->rating);
+          mp_str (out, "min_age");
+          if (min_age (r->rating))
+            mp_uint (out, min_age (r->rating));
+          else
+            mp_nil (out);
+        }
+    }
+
+  if (errmsg)
+    {
+      mp_str (out, "error");
+      mp_str (out, errmsg);
+    }
+
+  if (! out->failed)
+    {
+      size_t len = out->len - start - 4;
+      for (int k = 0; k < 4; ++k)
+        out->data[start + k] = len >> (8 * (3 - k));
+    }
+}
+
+void output_event (struct outbuf *out, enum output_format fmt, unsigned fields, const char *fn,
+                   const struct eit_section *sec, const struct eit_event *ev, const char *errmsg)
+{
+  switch (fmt)
+    {
+    case OUTPUT_JSON:
+      output_json (out, fields, ev, errmsg);
+      break;
+    case OUTPUT_NDJSON:
+      output_ndjson (out, fields, fn, sec, ev, errmsg);
+      break;
+    case OUTPUT_BIN:
+      output_bin (out, fields, fn, sec, ev, errmsg);
+      break;
+    }
+}
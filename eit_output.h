@@ -0,0 +1,47 @@
+/*!
+  \file eit_output.h
+
+  Ausgabeformate von parse_eit (--format=json|ndjson|bin)
+*/
+
+#ifndef EIT_OUTPUT_H
+#define EIT_OUTPUT_H
+
+#include "parse_eit.h"
+#include "outbuf.h"
+
+enum output_format
+{
+  OUTPUT_JSON = 0,    // eingerücktes JSON, ein Objekt pro Datei mit "empty_structure" Block
+  OUTPUT_NDJSON,      // ein kompaktes JSON Objekt pro Zeile
+  OUTPUT_BIN          // pro Datei uint32_t Länge (big endian) + MessagePack map
+};
+
+// "json", "ndjson" oder "bin", Rückgabe -1 bei unbekanntem Namen
+int output_format_from_name (const char *name);
+
+/*
+  --fields=event_name,start_time,...: kommagetrennte Liste aus event_id, start_time, duration,
+  running_status, free_CA_mode, event_name, text, extended, component, content, parental_rating.
+  Rückgabe enum eit_field Bits, -1 bei unbekanntem Namen
+*/
+int output_fields_from_list (const char *list);
+
+/*
+  Anfang des JSON Objekts bis einschließlich "filename", bei Lesefehlern bleibt es dabei.
+  Bei Events aus einer section (sec != NULL) folgen die Felder aus deren Kopf.
+*/
+void output_json_head (struct outbuf *out, const char *fn, const struct eit_section *sec);
+
+/*
+  Ein Datensatz für die Datei fn bzw. ein Event aus der section sec. errmsg ist NULL, wenn eit_parse
+  erfolgreich war, sonst enthält der Datensatz "error". Bei OUTPUT_JSON muss vorher
+  output_json_head geschrieben worden sein.
+  Es werden nur die Felder aus fields (enum eit_field) ausgegeben, "filename" und
+  "iso_639_2_language_code" sind immer dabei. Mit ev == NULL (Datei nicht lesbar)
+  enthält der Datensatz nur "filename" und "error".
+*/
+void output_event (struct outbuf *out, enum output_format fmt, unsigned fields, const char *fn,
+                   const struct eit_section *sec, const struct eit_event *ev, const char *errmsg);
+
+#endif
@@ -0,0 +1,858 @@
+/*!
+  \file eit_parse.c
+  \author Andreas Weber
+
+  tool for parsing EIT (DVB Event Information Table) files
+  Copyright (C) 2016..2023 Andreas Weber
+
+  Parser für .eit Dateien einer DreamBox 7025+ (vielleicht auch andere),
+  das Ergebnis landet in einer struct eit_event (siehe parse_eit.h).
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+#include "eit_internal.h"
+
+//#define DEBUG
+
+// Seite 39, Tabelle 12
+#define SHORT_EVENT_DESCRIPTOR 0x4d
+#define EXTENDED_EVENT_DESCRIPTOR 0x4e
+#define COMPONENT_DESCRIPTOR 0x50
+#define CONTENT_DESCRIPTOR 0x54
+#define PARENTAL_RATING_DESCRIPTOR 0x55
+
+/*
+  5.2.4 Event Information Table (EIT) : Seite 35
+
+  duration: A 24-bit field containing the duration of the event in hours, minutes, seconds. format: 6 digits,
+  4-bit BCD = 24 bit.
+
+  EXAMPLE 3:
+    01:45:30 is coded as "0x014530".
+*/
+
+uint8_t parse_duration (const uint8_t *p, size_t len, struct eit_duration *s)
+{
+  if (len < 3)
+    return 0;
+
+  s->hour   = (p[0] >> 4) * 10 + (p[0] & 0x0F);
+  s->minute = (p[1] >> 4) * 10 + (p[1] & 0x0F);
+  s->second = (p[2] >> 4) * 10 + (p[2] & 0x0F);
+  return 3;
+}
+
+/*
+  5.2.4 Event Information Table (EIT) : Seite 35
+
+  start_time: This 40-bit field contains the start time of the event in Universal Time, Co-ordinated (UTC) and Modified
+    Julian Date (MJD) (see annex C). This field is coded as 16 bits giving the 16 LSBs of MJD followed by 24 bits coded as
+    6 digits in 4-bit Binary Coded Decimal (BCD). If the start time is undefined (e.g. for an event in a NVOD reference
+    service) all bits of the field are set to "1".
+
+  EXAMPLE 1:
+    93/10/13 12:45:00 is coded as "0xC079124500".
+*/
+
+uint8_t parse_start_time (const uint8_t *p, size_t len, struct eit_start_time *s)
+{
+  if (len < 5)
+    return 0;
+
+  memset (s, 0, sizeof (*s));
+  if ((p[0] & p[1] & p[2] & p[3] & p[4]) == 0xFF)
+    {
+      s->undefined = 1;
+      return 5;
+    }
+
+  /*
+    Seite 145: Annex C rechnet mit double (/ 365.25, / 30.6001), das ist auf
+    Receivern ohne FPU teuer. Stattdessen das ganzzahlige days_from_civil
+    Verfahren rückwärts (H. Hinnant, "chrono-Compatible Low-Level Date
+    Algorithms"), Tage ab dem 1. März 0000. Für alle MJD ab 1900-03-01
+    (15079) ist das Ergebnis identisch mit Annex C.
+  */
+  int MJD = p[0] << 8 | p[1];
+
+  int z = MJD - 40587 + 719468;   // MJD 40587 = 1970-01-01
+  int era = z / 146097;           // 400 Jahre, z ist für MJD >= 0 positiv
+  int doe = z - era * 146097;
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;   // Monat ab März
+  int y = yoe + era * 400;
+
+  s->D = doy - (153 * mp + 2) / 5 + 1;
+  s->M = (mp < 10)? mp + 3 : mp - 9;
+  s->Y = y + (s->M <= 2) - 1900;
+
+  parse_duration (p + 2, len - 2, &s->t);
+
+  s->unix_time = (int64_t) (MJD - 40587) * 86400 + s->t.hour * 3600 + s->t.minute * 60 + s->t.second;
+
+  return 5;
+}
+
+void eit_ctx_init (struct eit_ctx *ctx)
+{
+  memset (ctx, 0, sizeof (*ctx));
+  ctx->fields = EIT_FIELD_ALL;
+}
+
+void eit_ctx_set_fields (struct eit_ctx *ctx, unsigned fields)
+{
+  ctx->fields = fields;
+}
+
+void eit_ctx_set_stats (struct eit_ctx *ctx, struct eit_stats *stats)
+{
+  ctx->stats = stats;
+}
+
+void eit_ctx_free (struct eit_ctx *ctx)
+{
+  eit_arena_free (ctx);
+  free (ctx->short_events);
+  free (ctx->extended_events);
+  free (ctx->components);
+  free (ctx->contents);
+  free (ctx->parental_ratings);
+  eit_close_iconv_cache (ctx);
+  memset (ctx, 0, sizeof (*ctx));
+}
+
+int eit_set_error (struct eit_ctx *ctx, int err, const char *fmt, ...)
+{
+  if (ctx->stats && err < 0 && err > -EIT_NUM_ERRORS)
+    ctx->stats->errors[-err]++;
+
+  // nur der erste Fehler wird beschrieben, gezählt werden alle
+  if (! ctx->num_errors++)
+    {
+      ctx->error = err;
+      va_list ap;
+      va_start (ap, fmt);
+      vsnprintf (ctx->errmsg, sizeof (ctx->errmsg), fmt, ap);
+      va_end (ap);
+    }
+  return err;
+}
+
+static void reset_errors (struct eit_ctx *ctx)
+{
+  ctx->errmsg[0] = 0;
+  ctx->error = EIT_OK;
+  ctx->num_errors = 0;
+}
+
+const char *eit_ctx_errmsg (const struct eit_ctx *ctx)
+{
+  return ctx->errmsg;
+}
+
+// Seite 49, Tabelle 29: content_nibble_level_1
+const char *eit_content_genre (uint8_t level_1)
+{
+  static const char *genres[16] =
+  {
+    "undefined content",
+    "Movie/Drama",
+    "News/Current affairs",
+    "Show/Game show",
+    "Sports",
+    "Children's/Youth programmes",
+    "Music/Ballet/Dance",
+    "Arts/Culture (without music)",
+    "Social/Political issues/Economics",
+    "Education/Science/Factual topics",
+    "Leisure hobbies",
+    "Special characteristics",
+    "Adult",
+    "reserved for future use",
+    "reserved for future use",
+    "user defined"
+  };
+  return genres[level_1 & 0x0F];
+}
+
+const char *eit_strerror (int err)
+{
+  switch (err)
+    {
+    case EIT_OK:
+      return "no error";
+    case EIT_ERR_TRUNCATED:
+      return "truncated EIT";
+    case EIT_ERR_CODE_TABLE:
+      return "invalid character code table";
+    case EIT_ERR_ICONV:
+      return "character code table not supported by iconv";
+    case EIT_ERR_CHARSET:
+      return "invalid multibyte sequence";
+    case EIT_ERR_TOO_BIG:
+      return "decoded text too long";
+    case EIT_ERR_NOT_IMPLEMENTED:
+      return "not implemented";
+    case EIT_ERR_UNKNOWN_DESCRIPTOR:
+      return "unknown descriptor_tag";
+    case EIT_ERR_NOMEM:
+      return "out of memory";
+    case EIT_ERR_NOT_EIT:
+      return "not an EIT section";
+    case EIT_ERR_CRC:
+      return "CRC_32 mismatch";
+    default:
+      return "unknown error";
+    }
+}
+
+// Platz für ein weiteres Element in einem der Arrays des Kontexts
+static void *grow (void *array, size_t *max, size_t num, size_t size)
+{
+  if (num < *max)
+    return array;
+
+  size_t n = *max ? 2 * *max : 4;
+  void *tmp = realloc (array, n * size);
+  if (tmp)
+    *max = n;
+  return tmp;
+}
+
+/*
+  Lesezeiger über einen Descriptor. Die feste Mindestlänge jedes Descriptors
+  (descriptor_handlers[].min_length) prüft parse_descriptors einmal gegen
+  descriptor_length, bis dahin lesen cursor_u8 und cursor_skip ungeprüft.
+  Für die Felder mit eigener Länge danach prüft cursor_field diese Länge.
+*/
+struct s_cursor
+{
+  const uint8_t *p;
+  const uint8_t *end;
+};
+
+static inline size_t cursor_left (const struct s_cursor *c)
+{
+  return c->end - c->p;
+}
+
+static inline uint8_t cursor_u8 (struct s_cursor *c)
+{
+  return *(c->p++);
+}
+
+// Rückgabe der Anfang der übersprungenen n Byte
+static inline const uint8_t *cursor_skip (struct s_cursor *c, size_t n)
+{
+  const uint8_t *p = c->p;
+  c->p += n;
+  return p;
+}
+
+// Feld mit vorangestellter 8 bit Länge, Rückgabe -1 wenn Länge oder Daten fehlen
+static inline int cursor_field (struct s_cursor *c, const uint8_t **p, uint8_t *len)
+{
+  if (c->p == c->end || cursor_left (c) - 1 < c->p[0])
+    return -1;
+  *len = c->p[0];
+  *p = c->p + 1;
+  c->p += 1 + *len;
+  return 0;
+}
+
+static void copy_language (char *dst, const uint8_t *p)
+{
+  memcpy (dst, p, 3);
+  dst[3] = 0;
+}
+
+/*
+  Die Fragmente einer extended_event_descriptor Kette (descriptor_number
+  0..last_descriptor_number) werden gesammelt und erst am Ende zusammen
+  dekodiert, so gibt es auch keine auf zwei Descriptoren verteilten Zeichen mehr.
+*/
+#define MAX_EXT_CHAINS 8
+#define MAX_EXT_FRAGMENTS 16   // descriptor_number ist 4 bit
+
+// ein item_description/item Paar, das item kann in den folgenden Descriptoren weitergehen
+struct s_ext_item
+{
+  struct s_ext_item *next;
+  const uint8_t *description;
+  uint8_t description_length;
+  int num_fragments;
+  const uint8_t *item[MAX_EXT_FRAGMENTS];
+  uint8_t item_length[MAX_EXT_FRAGMENTS];
+};
+
+struct s_ext_chain
+{
+  size_t index;       // in out->extended_events
+  char language[4];
+  uint8_t last_descriptor_number;
+  int num_fragments;
+  const uint8_t *text[MAX_EXT_FRAGMENTS];
+  uint8_t text_length[MAX_EXT_FRAGMENTS];
+
+  // Liste der items aus eit_alloc
+  struct s_ext_item *items;
+  struct s_ext_item *last_item;
+  size_t num_items;
+};
+
+struct s_ext_chains
+{
+  int num;
+  struct s_ext_chain chain[MAX_EXT_CHAINS];
+};
+
+// setzt Text-Fragmente zusammen und dekodiert sie in einem Durchgang
+static int decode_fragments (struct eit_ctx *ctx, const uint8_t * const *frag, const uint8_t *frag_length,
+                             int num_fragments, char **out)
+{
+  *out = "";
+  if (! num_fragments)
+    return EIT_OK;
+
+  size_t len = 0;
+  for (int k = 0; k < num_fragments; ++k)
+    len += frag_length[k];
+
+  uint8_t *joined = eit_alloc (ctx, len);
+  if (! joined)
+    return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+
+  // die Tabelle aus dem ersten nicht leeren Fragment gilt, wiederholt ein folgendes genau dieselben
+  // Auswahlbytes, werden sie übersprungen. Bei Tabellen mit zwei Byte je Zeichen (Tabelle A.3, 0x11 bis 0x14)
+  // nie, dort beginnt ein Fragment meist mit dem high byte 0x00 und wäre sonst um ein Byte verschoben
+  int first = 0;
+  while (first < num_fragments - 1 && ! frag_length[first])
+    first++;
+  const char *code_table;
+  size_t sel = get_code_table (frag[first], frag_length[first], &code_table);
+  if (sel == (size_t) -1 || (sel && frag[first][0] >= 0x11 && frag[first][0] <= 0x14))
+    sel = 0;
+
+  size_t n = 0;
+  for (int k = 0; k < num_fragments; ++k)
+    {
+      const uint8_t *t = frag[k];
+      size_t t_len = frag_length[k];
+      if (k > first && sel && t_len >= sel && ! memcmp (t, frag[first], sel))
+        {
+          t += sel;
+          t_len -= sel;
+        }
+      memcpy (joined + n, t, t_len);
+      n += t_len;
+    }
+
+  return eit_decode_text (ctx, joined, n, out);
+}
+
+// dekodiert Text und items einer Kette, Rückgabe der erste Fehler
+static int finish_ext_chain (struct eit_ctx *ctx, struct eit_event *out, struct s_ext_chain *c)
+{
+  struct eit_extended_event *ee = &out->extended_events[c->index];
+  if (ctx->stats)
+    ctx->stats->extended_chains[c->num_fragments]++;
+
+  int ret = decode_fragments (ctx, c->text, c->text_length, c->num_fragments, &ee->text);
+  if (ret == EIT_ERR_NOMEM || ! c->num_items)
+    return ret;
+
+  ee->items = eit_alloc (ctx, c->num_items * sizeof (struct eit_extended_item));
+  if (! ee->items)
+    return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+
+  // erst nach beiden Strings mitzählen, bei Speichermangel stünde in item sonst ein ungültiger Zeiger
+  for (struct s_ext_item *i = c->items; i; i = i->next)
+    {
+      struct eit_extended_item *item = &ee->items[ee->num_items];
+      int r = decode_fragments (ctx, &i->description, &i->description_length, 1, &item->description);
+      if (r != EIT_ERR_NOMEM)
+        r = decode_fragments (ctx, i->item, i->item_length, i->num_fragments, &item->item);
+      if (r == EIT_ERR_NOMEM)
+        return r;
+      ee->num_items++;
+      if (! ret)
+        ret = r;
+    }
+  return ret;
+}
+
+// Tabelle 53, Seite 64: die items eines Descriptors zur Kette hinzufügen
+static int add_ext_items (struct eit_ctx *ctx, struct s_ext_chain *c, struct s_cursor *d)
+{
+  while (cursor_left (d))
+    {
+      const uint8_t *description, *item;
+      uint8_t item_description_length, item_length;
+      if (cursor_field (d, &description, &item_description_length) || ! cursor_left (d))
+        return eit_set_error (ctx, EIT_ERR_TRUNCATED, "item_description_length exceeds length_of_items");
+      if (cursor_field (d, &item, &item_length))
+        return eit_set_error (ctx, EIT_ERR_TRUNCATED, "item_length exceeds length_of_items");
+
+      // ohne item_description geht das vorige item weiter (auch über Descriptoren hinweg)
+      struct s_ext_item *i = c->last_item;
+      if (item_description_length > 0 || ! i)
+        {
+          i = eit_alloc (ctx, sizeof (struct s_ext_item));
+          if (! i)
+            return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+          i->next = NULL;
+          i->description = description;
+          i->description_length = item_description_length;
+          i->num_fragments = 0;
+
+          if (c->last_item)
+            c->last_item->next = i;
+          else
+            c->items = i;
+          c->last_item = i;
+          c->num_items++;
+        }
+
+      if (i->num_fragments < MAX_EXT_FRAGMENTS)
+        {
+          i->item[i->num_fragments] = item;
+          i->item_length[i->num_fragments] = item_length;
+          i->num_fragments++;
+        }
+    }
+  return EIT_OK;
+}
+
+static int finish_ext_chains (struct eit_ctx *ctx, struct eit_event *out, struct s_ext_chains *chains)
+{
+  int ret = EIT_OK;
+  for (int k = 0; k < chains->num; ++k)
+    {
+      int r = finish_ext_chain (ctx, out, &chains->chain[k]);
+      if (! ret)
+        ret = r;
+    }
+  chains->num = 0;
+  return ret;
+}
+
+// gibt die offene Kette für language zurück oder NULL
+static struct s_ext_chain *find_ext_chain (struct s_ext_chains *chains, const char *language)
+{
+  for (int k = 0; k < chains->num; ++k)
+    if (! memcmp (chains->chain[k].language, language, 4))
+      return &chains->chain[k];
+  return NULL;
+}
+
+// Seite 87, Kapitel 6.2.37 : Short event descriptor
+static int parse_short_event (struct s_cursor *d, struct eit_event *out, struct eit_ctx *ctx,
+                              struct s_ext_chains *chains)
+{
+  (void) chains;
+
+  struct eit_short_event *tmp = grow (ctx->short_events, &ctx->max_short_events, out->num_short_events, sizeof (struct eit_short_event));
+  if (! tmp)
+    return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+  out->short_events = ctx->short_events = tmp;
+
+  struct eit_short_event se;
+  copy_language (se.language, cursor_skip (d, 3));
+
+  const uint8_t *event_name, *text;
+  uint8_t event_name_length, text_length;
+  if (cursor_field (d, &event_name, &event_name_length) || ! cursor_left (d))
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "event_name_length exceeds short_event_descriptor");
+  if (cursor_field (d, &text, &text_length))
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "text_length exceeds short_event_descriptor");
+
+  se.event_name = NULL;
+  if (ctx->fields & EIT_FIELD_EVENT_NAME)
+    {
+      int ret = eit_decode_text (ctx, event_name, event_name_length, &se.event_name);
+      if (ret)
+        return ret;
+    }
+
+  se.text = NULL;
+  if (ctx->fields & EIT_FIELD_TEXT)
+    {
+      int ret = eit_decode_text (ctx, text, text_length, &se.text);
+      if (ret)
+        return ret;
+    }
+
+  out->short_events[out->num_short_events++] = se;
+  return EIT_OK;
+}
+
+// Seite 64, Kapitel 6.2.15 : Extended event descriptor
+static int parse_extended_event (struct s_cursor *d, struct eit_event *out, struct eit_ctx *ctx,
+                                 struct s_ext_chains *chains)
+{
+  uint8_t numbers = cursor_u8 (d);
+  uint8_t descriptor_number = numbers >> 4;
+  uint8_t last_descriptor_number = numbers & 0x0F;
+
+#ifdef DEBUG
+  fprintf (stderr, "descriptor_number = %i\n", descriptor_number);
+  fprintf (stderr, "last_descriptor_number = %i\n", last_descriptor_number);
+#endif
+
+  char language[4];
+  copy_language (language, cursor_skip (d, 3));
+
+  struct s_ext_chain *c = find_ext_chain (chains, language);
+
+  // eine neue Kette beginnt, eine noch offene mit derselben Sprache ist damit zu Ende
+  if (c && descriptor_number == 0)
+    {
+      int ret = finish_ext_chain (ctx, out, c);
+      *c = chains->chain[--chains->num];
+      c = NULL;
+      if (ret == EIT_ERR_NOMEM)
+        return ret;
+    }
+
+  if (! c)
+    {
+      if (chains->num == MAX_EXT_CHAINS)
+        {
+          int ret = finish_ext_chains (ctx, out, chains);
+          if (ret == EIT_ERR_NOMEM)
+            return ret;
+        }
+
+      struct eit_extended_event *tmp = grow (ctx->extended_events, &ctx->max_extended_events, out->num_extended_events, sizeof (struct eit_extended_event));
+      if (! tmp)
+        return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+      out->extended_events = ctx->extended_events = tmp;
+
+      struct eit_extended_event *ee = &out->extended_events[out->num_extended_events];
+      memset (ee, 0, sizeof (*ee));
+      memcpy (ee->language, language, 4);
+      ee->text = "";
+
+      c = &chains->chain[chains->num++];
+      memset (c, 0, sizeof (*c));
+      c->index = out->num_extended_events++;
+      memcpy (c->language, language, 4);
+    }
+  c->last_descriptor_number = last_descriptor_number;
+
+  // Tabelle 53, Seite 64, length_of_items kann auch 0 sein
+  struct s_cursor items;
+  uint8_t length_of_items;
+  if (cursor_field (d, &items.p, &length_of_items) || ! cursor_left (d))
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "length_of_items exceeds extended_event_descriptor");
+  items.end = items.p + length_of_items;
+
+  int ret = add_ext_items (ctx, c, &items);
+  if (ret)
+    return ret;
+
+  const uint8_t *text;
+  uint8_t text_length;
+  if (cursor_field (d, &text, &text_length))
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "text_length exceeds extended_event_descriptor");
+
+  if (c->num_fragments < MAX_EXT_FRAGMENTS)
+    {
+      c->text[c->num_fragments] = text;
+      c->text_length[c->num_fragments] = text_length;
+      c->num_fragments++;
+    }
+
+  // Sind wir am Ende?
+  if (descriptor_number == last_descriptor_number)
+    {
+      ret = finish_ext_chain (ctx, out, c);
+      *c = chains->chain[--chains->num];
+      if (ret == EIT_ERR_NOMEM)
+        return ret;
+    }
+
+  return EIT_OK;
+}
+
+// Seite 46, Kapitel 6.2.8 : Component descriptor
+static int parse_component (struct s_cursor *d, struct eit_event *out, struct eit_ctx *ctx,
+                            struct s_ext_chains *chains)
+{
+  (void) chains;
+
+#ifdef DEBUG
+  fprintf (stderr, "COMPONENT_DESCRIPTOR\n");
+  fprintf (stderr, "stream_content_ext = %i\n", d->p[0] >> 4);
+  fprintf (stderr, "stream_content = %i\n", d->p[0] & 0x0F);
+  fprintf (stderr, "component_type = %i\n", d->p[1]);
+  fprintf (stderr, "component_tag = %i\n", d->p[2]);
+#endif
+
+  struct eit_component *tmp = grow (ctx->components, &ctx->max_components, out->num_components, sizeof (struct eit_component));
+  if (! tmp)
+    return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+  out->components = ctx->components = tmp;
+
+  struct eit_component c;
+  uint8_t stream_content = cursor_u8 (d);
+  c.stream_content_ext = stream_content >> 4;
+  c.stream_content = stream_content & 0x0F;
+  c.component_type = cursor_u8 (d);
+  c.component_tag = cursor_u8 (d);
+  copy_language (c.language, cursor_skip (d, 3));
+
+  // der Text ist der Rest des Descriptors
+  int ret = eit_decode_text (ctx, d->p, cursor_left (d), &c.text);
+  if (ret)
+    return ret;
+
+  out->components[out->num_components++] = c;
+  return EIT_OK;
+}
+
+// Seite 48, Kapitel 6.2.9 : Content descriptor, je 2 Byte
+static int parse_content (struct s_cursor *d, struct eit_event *out, struct eit_ctx *ctx,
+                          struct s_ext_chains *chains)
+{
+  (void) chains;
+  while (cursor_left (d) >= 2)
+    {
+      struct eit_content *tmp = grow (ctx->contents, &ctx->max_contents, out->num_contents, sizeof (struct eit_content));
+      if (! tmp)
+        return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+      out->contents = ctx->contents = tmp;
+
+      struct eit_content *c = &out->contents[out->num_contents++];
+      uint8_t nibbles = cursor_u8 (d);
+      c->level_1 = nibbles >> 4;
+      c->level_2 = nibbles & 0x0F;
+      c->user_byte = cursor_u8 (d);
+    }
+
+  if (cursor_left (d))
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "content_descriptor length not a multiple of 2");
+  return EIT_OK;
+}
+
+// Seite 83, Kapitel 6.2.28 : Parental rating descriptor, je 4 Byte
+static int parse_parental_rating (struct s_cursor *d, struct eit_event *out, struct eit_ctx *ctx,
+                                  struct s_ext_chains *chains)
+{
+  (void) chains;
+  while (cursor_left (d) >= 4)
+    {
+      struct eit_parental_rating *tmp = grow (ctx->parental_ratings, &ctx->max_parental_ratings, out->num_parental_ratings, sizeof (struct eit_parental_rating));
+      if (! tmp)
+        return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+      out->parental_ratings = ctx->parental_ratings = tmp;
+
+      struct eit_parental_rating *r = &out->parental_ratings[out->num_parental_ratings++];
+      copy_language (r->country, cursor_skip (d, 3));
+      r->rating = cursor_u8 (d);
+    }
+
+  if (cursor_left (d))
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "parental_rating_descriptor length not a multiple of 4");
+  return EIT_OK;
+}
+
+// d enthält mindestens min_length Byte
+typedef int (*descriptor_handler) (struct s_cursor *d, struct eit_event *out, struct eit_ctx *ctx,
+                                   struct s_ext_chains *chains);
+
+/*
+  Seite 39, Tabelle 12: unterstützte descriptor_tag, die enum eit_field Bits, für die sie gebraucht
+  werden, und die Länge der festen Felder bis einschließlich des ersten Längenbytes
+*/
+static const struct
+{
+  descriptor_handler handler;
+  unsigned fields;
+  uint8_t min_length;
+  const char *name;
+} descriptor_handlers[256] =
+{
+  [SHORT_EVENT_DESCRIPTOR] = {parse_short_event, EIT_FIELD_EVENT_NAME | EIT_FIELD_TEXT, 5, "short_event_descriptor"},
+  [EXTENDED_EVENT_DESCRIPTOR] = {parse_extended_event, EIT_FIELD_EXTENDED, 6, "extended_event_descriptor"},
+  [COMPONENT_DESCRIPTOR] = {parse_component, EIT_FIELD_COMPONENT, 6, "component_descriptor"},
+  [CONTENT_DESCRIPTOR] = {parse_content, EIT_FIELD_CONTENT, 0, "content_descriptor"},
+  [PARENTAL_RATING_DESCRIPTOR] = {parse_parental_rating, EIT_FIELD_PARENTAL_RATING, 0, "parental_rating_descriptor"}
+};
+
+/*
+  Fehler in einem Descriptor (ungültiger Text, falsche Längen, ...) werden mit
+  eit_set_error gezählt und der Descriptor über descriptor_length übersprungen,
+  ebenso alle descriptor_tag ohne Handler und nicht gewählte Descriptoren.
+  Abgebrochen wird nur, wenn die Descriptoren selbst nicht mehr zusammenpassen.
+*/
+static int parse_descriptors (const uint8_t *p, const uint8_t *end, struct eit_event *out, struct eit_ctx *ctx,
+                              struct s_ext_chains *chains)
+{
+  struct s_cursor loop = {p, end};
+  while (cursor_left (&loop))
+    {
+      if (cursor_left (&loop) < 2)
+        return eit_set_error (ctx, EIT_ERR_TRUNCATED, "truncated descriptor header");
+
+      uint8_t descriptor_tag = cursor_u8 (&loop);
+      uint8_t descriptor_length = cursor_u8 (&loop);  // Länge der folgenden Daten in Bytes
+
+      if (ctx->stats)
+        ctx->stats->descriptors[descriptor_tag]++;
+
+      if (descriptor_length > cursor_left (&loop))
+        return eit_set_error (ctx, EIT_ERR_TRUNCATED, "descriptor_tag %#x, descriptor_length=%i exceeds EIT, bytes left = %zu",
+                              descriptor_tag, descriptor_length, cursor_left (&loop));
+
+      // der Handler sieht nur diesen Descriptor
+      struct s_cursor d = {loop.p, loop.p + descriptor_length};
+      loop.p = d.end;
+
+      if (! descriptor_handlers[descriptor_tag].handler
+          || ! (ctx->fields & descriptor_handlers[descriptor_tag].fields))
+        out->num_skipped_descriptors++;
+      else if (descriptor_length < descriptor_handlers[descriptor_tag].min_length)
+        eit_set_error (ctx, EIT_ERR_TRUNCATED, "%s too short", descriptor_handlers[descriptor_tag].name);
+      else
+        {
+          int ret = descriptor_handlers[descriptor_tag].handler (&d, out, ctx, chains);
+          if (ret == EIT_ERR_NOMEM)
+            return ret;
+        }
+    }
+
+  return EIT_OK;
+}
+
+// gemeinsamer Anfang von eit_parse und eit_parse_event
+static int begin_event (size_t num, struct eit_event *out, struct eit_ctx *ctx)
+{
+  reset_errors (ctx);
+  memset (out, 0, sizeof (*out));
+  out->short_events = ctx->short_events;
+  out->extended_events = ctx->extended_events;
+  out->components = ctx->components;
+  out->contents = ctx->contents;
+  out->parental_ratings = ctx->parental_ratings;
+
+  // UTF-8 braucht höchstens 3 Byte je Eingabebyte (z.B. € aus ISO-8859-15),
+  // dazu die zusammengesetzten extended_event_descriptor Texte
+  if (eit_arena_reset (ctx, 4 * num + 256))
+    return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+
+  // 5.2.4 Event Information Table (EIT), Seite 35: 12 Byte bis zur descriptor loop
+  if (num < 12)
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "EIT too short (%zu bytes)", num);
+
+  return EIT_OK;
+}
+
+// die 12 Byte von event_id bis descriptors_loop_length
+static const uint8_t *parse_event_header (const uint8_t *p, struct eit_event *out)
+{
+  out->event_id = p[0] << 8 | p[1];
+  p += 2;
+
+  p += parse_start_time (p, 5, &out->start_time);
+  p += parse_duration (p, 3, &out->duration);
+
+  // Tabelle 7: running_status (3 bit), free_CA_mode (1 bit), descriptors_loop_length (12 bit)
+  // undefined = 0, not_running, starts_in_a_few_seconds, pausing, running, serive_off_air, reserved1, reserved2
+
+  out->running_status = p[0] >> 5;
+  out->free_CA_mode   = (p[0] >> 4) & 0x01;
+  out->descriptors_loop_length = (p[0] & 0x0F) << 8 | p[1];
+  return p + 2;
+}
+
+// Rückgabe der erste Fehler
+static int parse_event_descriptors (const uint8_t *p, const uint8_t *end, struct eit_event *out, struct eit_ctx *ctx)
+{
+  struct s_ext_chains chains;
+  chains.num = 0;
+  parse_descriptors (p, end, out, ctx, &chains);
+
+  // nicht abgeschlossene Ketten (auch nach einem Fehler) mit dem ausgeben, was da ist
+  finish_ext_chains (ctx, out, &chains);
+
+  out->num_errors = ctx->num_errors;
+  return ctx->error;
+}
+
+int eit_parse (const uint8_t *buf, size_t num, struct eit_event *out, struct eit_ctx *ctx)
+{
+  int ret = begin_event (num, out, ctx);
+  if (ret)
+    return ret;
+
+  // die .eit Datei endet mit der descriptor loop, descriptors_loop_length wird nicht ausgewertet
+  const uint8_t *p = parse_event_header (buf, out);
+  return parse_event_descriptors (p, buf + num, out, ctx);
+}
+
+int eit_parse_event (const uint8_t *buf, size_t len, size_t *consumed, struct eit_event *out, struct eit_ctx *ctx)
+{
+  *consumed = len;
+  int ret = begin_event (len, out, ctx);
+  if (ret)
+    return ret;
+
+  const uint8_t *p = parse_event_header (buf, out);
+  if (out->descriptors_loop_length > len - 12)
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "descriptors_loop_length=%i exceeds section, bytes left = %zu",
+                          out->descriptors_loop_length, len - 12);
+
+  *consumed = 12 + out->descriptors_loop_length;
+  return parse_event_descriptors (p, p + out->descriptors_loop_length, out, ctx);
+}
+
+int eit_parse_section (const uint8_t *buf, size_t len, struct eit_section *sec, struct eit_ctx *ctx)
+{
+  reset_errors (ctx);
+  memset (sec, 0, sizeof (*sec));
+
+  if (len < 3)
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "section too short (%zu bytes)", len);
+
+  sec->table_id = buf[0];
+  sec->section_length = (buf[1] & 0x0F) << 8 | buf[2];
+
+  // Tabelle 2, Seite 26: 0x4E..0x4F present/following, 0x50..0x6F schedule
+  if (sec->table_id < 0x4E || sec->table_id > 0x6F)
+    return eit_set_error (ctx, EIT_ERR_NOT_EIT, "table_id %#x is not an EIT", sec->table_id);
+
+  if (3 + (size_t) sec->section_length > len)
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "section_length=%i exceeds data, bytes left = %zu",
+                          sec->section_length, len - 3);
+
+  // 11 Byte Kopf nach section_length und CRC_32
+  if (sec->section_length < 15)
+    return eit_set_error (ctx, EIT_ERR_TRUNCATED, "section_length=%i too short", sec->section_length);
+
+  if (eit_crc32 (buf, 3 + sec->section_length) != 0)
+    return eit_set_error (ctx, EIT_ERR_CRC, "CRC_32 mismatch in section of service_id %i",
+                          buf[3] << 8 | buf[4]);
+
+  const uint8_t *p = buf + 3;
+  sec->service_id = p[0] << 8 | p[1];
+  sec->version_number = (p[2] >> 1) & 0x1F;
+  sec->current_next_indicator = p[2] & 0x01;
+  sec->section_number = p[3];
+  sec->last_section_number = p[4];
+  sec->transport_stream_id = p[5] << 8 | p[6];
+  sec->original_network_id = p[7] << 8 | p[8];
+  sec->segment_last_section_number = p[9];
+  sec->last_table_id = p[10];
+
+  sec->events = p + 11;
+  sec->events_len = sec->section_length - 15;
+  return EIT_OK;
+}
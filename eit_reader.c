@@ -0,0 +1,549 @@
+/*!
+  \file eit_reader.c
+
+  Vorauslesen der .eit Dateien für --prefetch, siehe eit_reader.h
+
+  Datei k liegt in slots[k % depth], begonnen wird sie erst, wenn Datei
+  k - depth abgeholt und wieder freigegeben ist. So bleibt die Reihenfolge
+  erhalten und es sind nie mehr als depth Dateien im Speicher.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined (__NR_io_uring_setup) && defined (__has_include)
+#if __has_include (<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#include "eit_reader.h"
+#include "eit_file.h"
+
+// so viel wird per io_uring gelesen, größere Dateien danach synchron mit eit_file_load
+#define URING_READ_SIZE (16 * 1024)
+
+// höchstens so viele Threads ohne io_uring
+#define MAX_THREADS 64
+
+enum slot_state
+{
+  SLOT_FREE,
+  SLOT_BUSY,
+  SLOT_DONE
+};
+
+struct s_slot
+{
+  size_t file;          // Index in files
+  enum slot_state state;
+  int fd;
+  int err;              // errno, wenn die Datei nicht gelesen werden konnte
+  const uint8_t *data;
+  size_t len;
+  uint8_t *buf;         // URING_READ_SIZE, nur mit io_uring
+  struct eit_file f;    // ohne io_uring und für große Dateien
+};
+
+#ifdef HAVE_IO_URING
+enum uring_op
+{
+  OP_OPEN,
+  OP_READ,
+  OP_CLOSE
+};
+
+struct s_uring
+{
+  int fd;
+  unsigned entries;
+  unsigned to_submit;
+
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_ring;
+  size_t sq_ring_len;
+  void *cq_ring;
+  size_t cq_ring_len;
+  size_t sqes_len;
+};
+#endif
+
+struct eit_reader
+{
+  const char **files;
+  size_t num_files;
+  unsigned depth;
+  struct s_slot *slots;
+
+  size_t next;        // nächste Datei für eit_reader_next
+  size_t released;    // Dateien davor sind abgeholt und ihre Slots frei
+  size_t submitted;   // so viele Dateien sind begonnen
+
+  char use_uring;
+#ifdef HAVE_IO_URING
+  struct s_uring ring;
+  unsigned busy;      // Slots mit laufendem openat oder read
+#endif
+
+  // ohne io_uring
+  pthread_t threads[MAX_THREADS];
+  unsigned num_threads;
+  char stop;
+  pthread_mutex_t lock;
+  pthread_cond_t slot_done;
+  pthread_cond_t slot_free;
+};
+
+static void slot_done (struct s_slot *s, int err)
+{
+  s->err = err;
+  s->state = SLOT_DONE;
+}
+
+#ifdef HAVE_IO_URING
+
+static void uring_free (struct s_uring *u)
+{
+  if (u->sqes)
+    munmap (u->sqes, u->sqes_len);
+  if (u->cq_ring && u->cq_ring != u->sq_ring)
+    munmap (u->cq_ring, u->cq_ring_len);
+  if (u->sq_ring)
+    munmap (u->sq_ring, u->sq_ring_len);
+  if (u->fd >= 0)
+    close (u->fd);
+  memset (u, 0, sizeof (*u));
+  u->fd = -1;
+}
+
+static void *map_ring (int fd, size_t len, off_t offset)
+{
+  void *p = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+  return (p == MAP_FAILED) ? NULL : p;
+}
+
+// braucht openat, read und close als io_uring Operationen (Linux 5.6)
+static int uring_supported (struct s_uring *u)
+{
+  static const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+  struct io_uring_probe *probe = calloc (1, sizeof (*probe) + 256 * sizeof (struct io_uring_probe_op));
+  if (! probe)
+    return 0;
+
+  int ok = syscall (__NR_io_uring_register, u->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+  for (size_t k = 0; ok && k < sizeof (ops) / sizeof (ops[0]); ++k)
+    ok = probe->last_op >= ops[k] && (probe->ops[ops[k]].flags & IO_URING_OP_SUPPORTED);
+  free (probe);
+  return ok;
+}
+
+static int uring_setup (struct s_uring *u, unsigned entries)
+{
+  memset (u, 0, sizeof (*u));
+  struct io_uring_params p;
+  memset (&p, 0, sizeof (p));
+  u->fd = syscall (__NR_io_uring_setup, entries, &p);
+  if (u->fd < 0)
+    return -1;
+
+  u->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+  u->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if (u->cq_ring_len > u->sq_ring_len)
+        u->sq_ring_len = u->cq_ring_len;
+      u->sq_ring = map_ring (u->fd, u->sq_ring_len, IORING_OFF_SQ_RING);
+      u->cq_ring = u->sq_ring;
+    }
+  else
+    {
+      u->sq_ring = map_ring (u->fd, u->sq_ring_len, IORING_OFF_SQ_RING);
+      u->cq_ring = map_ring (u->fd, u->cq_ring_len, IORING_OFF_CQ_RING);
+    }
+  u->sqes_len = p.sq_entries * sizeof (struct io_uring_sqe);
+  u->sqes = map_ring (u->fd, u->sqes_len, IORING_OFF_SQES);
+
+  if (! u->sq_ring || ! u->cq_ring || ! u->sqes || ! uring_supported (u))
+    {
+      uring_free (u);
+      errno = ENOSYS;
+      return -1;
+    }
+
+  char *sq = u->sq_ring;
+  u->sq_head = (unsigned *) (sq + p.sq_off.head);
+  u->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+  u->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *) (sq + p.sq_off.array);
+  char *cq = u->cq_ring;
+  u->cq_head = (unsigned *) (cq + p.cq_off.head);
+  u->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+  u->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+  u->entries = p.sq_entries;
+  return 0;
+}
+
+// übergibt die eingetragenen Operationen, mit wait wird auf mindestens ein Ergebnis gewartet
+static int uring_enter (struct s_uring *u, char wait)
+{
+  for (;;)
+    {
+      long r = syscall (__NR_io_uring_enter, u->fd, u->to_submit, wait ? 1 : 0,
+                        wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+      if (r >= 0)
+        {
+          u->to_submit -= r;
+          if (! u->to_submit || wait)
+            return 0;
+        }
+      else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        return -1;
+    }
+}
+
+static int uring_push (struct s_uring *u, uint8_t opcode, int fd, const void *addr, unsigned len, uint64_t user_data)
+{
+  unsigned tail = *u->sq_tail;
+  if (tail - __atomic_load_n (u->sq_head, __ATOMIC_ACQUIRE) >= u->entries)
+    {
+      if (uring_enter (u, 0))
+        return -1;
+      tail = *u->sq_tail;
+    }
+
+  unsigned idx = tail & *u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[idx];
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) addr;
+  sqe->len = len;
+  sqe->user_data = user_data;
+  if (opcode == IORING_OP_OPENAT)
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+  u->sq_array[idx] = idx;
+  __atomic_store_n (u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  u->to_submit++;
+  return 0;
+}
+
+// das Ergebnis einer Operation, user_data ist Dateinummer << 2 | enum uring_op
+static void uring_complete (struct eit_reader *r, uint64_t user_data, int res)
+{
+  enum uring_op op = user_data & 3;
+  size_t file = user_data >> 2;
+  struct s_slot *s = &r->slots[file % r->depth];
+
+  if (op == OP_CLOSE)
+    return;
+  r->busy--;
+
+  if (op == OP_OPEN)
+    {
+      if (res < 0)
+        slot_done (s, -res);
+      else
+        {
+          s->fd = res;
+          if (uring_push (&r->ring, IORING_OP_READ, s->fd, s->buf, URING_READ_SIZE, file << 2 | OP_READ))
+            {
+              close (s->fd);
+              slot_done (s, errno);
+            }
+          else
+            r->busy++;
+        }
+      return;
+    }
+
+  int err = 0;
+  if (res < 0)
+    err = -res;
+  else if (res == URING_READ_SIZE)
+    {
+      // passt nicht in den Puffer, dann eben synchron (mit mmap für ganz große)
+      if (eit_file_load (&s->f, r->files[file]))
+        err = errno;
+      else
+        {
+          s->data = s->f.data;
+          s->len = s->f.len;
+        }
+    }
+  else
+    {
+      s->data = s->buf;
+      s->len = res;
+    }
+
+  if (uring_push (&r->ring, IORING_OP_CLOSE, s->fd, NULL, 0, file << 2 | OP_CLOSE))
+    close (s->fd);
+  s->fd = -1;
+  slot_done (s, err);
+}
+
+// alle schon vorliegenden Ergebnisse abarbeiten, ohne Syscall
+static void uring_reap (struct eit_reader *r)
+{
+  struct s_uring *u = &r->ring;
+  unsigned head = *u->cq_head;
+  while (head != __atomic_load_n (u->cq_tail, __ATOMIC_ACQUIRE))
+    {
+      struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+      uint64_t user_data = cqe->user_data;
+      int res = cqe->res;
+      __atomic_store_n (u->cq_head, ++head, __ATOMIC_RELEASE);
+      uring_complete (r, user_data, res);
+    }
+}
+
+static void uring_start (struct eit_reader *r, size_t file)
+{
+  struct s_slot *s = &r->slots[file % r->depth];
+  if (uring_push (&r->ring, IORING_OP_OPENAT, AT_FDCWD, r->files[file], 0, file << 2 | OP_OPEN))
+    slot_done (s, errno);
+  else
+    r->busy++;
+}
+
+#endif
+
+// ohne io_uring: jeder Thread liest die nächste noch nicht begonnene Datei
+static void *reader_thread (void *arg)
+{
+  struct eit_reader *r = arg;
+  pthread_mutex_lock (&r->lock);
+  for (;;)
+    {
+      while (! r->stop && r->submitted < r->num_files && r->submitted >= r->released + r->depth)
+        pthread_cond_wait (&r->slot_free, &r->lock);
+      if (r->stop || r->submitted >= r->num_files)
+        break;
+
+      size_t file = r->submitted++;
+      struct s_slot *s = &r->slots[file % r->depth];
+      s->file = file;
+      s->state = SLOT_BUSY;
+      pthread_mutex_unlock (&r->lock);
+
+      int err = eit_file_load (&s->f, r->files[file]) ? errno : 0;
+
+      pthread_mutex_lock (&r->lock);
+      s->data = s->f.data;
+      s->len = s->f.len;
+      slot_done (s, err);
+      pthread_cond_broadcast (&r->slot_done);
+    }
+  pthread_mutex_unlock (&r->lock);
+  return NULL;
+}
+
+// neue Dateien beginnen, soweit Slots frei sind
+static void start_files (struct eit_reader *r)
+{
+  while (r->submitted < r->num_files && r->submitted < r->released + r->depth)
+    {
+      size_t file = r->submitted++;
+      struct s_slot *s = &r->slots[file % r->depth];
+      s->file = file;
+      s->state = SLOT_BUSY;
+      s->err = 0;
+      s->data = NULL;
+      s->len = 0;
+#ifdef HAVE_IO_URING
+      uring_start (r, file);
+#endif
+    }
+}
+
+struct eit_reader *eit_reader_open (const char **files, size_t num_files, unsigned depth)
+{
+  if (depth < 1)
+    depth = 1;
+
+  struct eit_reader *r = calloc (1, sizeof (*r));
+  if (! r)
+    return NULL;
+  r->files = files;
+  r->num_files = num_files;
+  r->depth = depth;
+  r->slots = calloc (depth, sizeof (struct s_slot));
+  if (! r->slots)
+    {
+      free (r);
+      return NULL;
+    }
+  for (unsigned k = 0; k < depth; ++k)
+    {
+      r->slots[k].fd = -1;
+      eit_file_init (&r->slots[k].f);
+    }
+
+#ifdef HAVE_IO_URING
+  // EIT_READER=threads erzwingt die Threads, z.B. zum Vergleich
+  const char *backend = getenv ("EIT_READER");
+  if ((! backend || strcmp (backend, "threads")) && uring_setup (&r->ring, 2 * depth) == 0)
+    {
+      r->use_uring = 1;
+      for (unsigned k = 0; k < depth; ++k)
+        {
+          r->slots[k].buf = malloc (URING_READ_SIZE);
+          if (! r->slots[k].buf)
+            {
+              eit_reader_close (r);
+              return NULL;
+            }
+        }
+      start_files (r);
+      if (uring_enter (&r->ring, 0) == 0)
+        return r;
+
+      // io_uring_enter geht nicht (z.B. seccomp): doch mit Threads
+      uring_free (&r->ring);
+      r->use_uring = 0;
+      r->busy = 0;
+      r->submitted = 0;
+      for (unsigned k = 0; k < depth; ++k)
+        {
+          free (r->slots[k].buf);
+          r->slots[k].buf = NULL;
+          r->slots[k].state = SLOT_FREE;
+        }
+    }
+#endif
+
+  pthread_mutex_init (&r->lock, NULL);
+  pthread_cond_init (&r->slot_done, NULL);
+  pthread_cond_init (&r->slot_free, NULL);
+  unsigned n = (depth < MAX_THREADS) ? depth : MAX_THREADS;
+  for (; r->num_threads < n; ++r->num_threads)
+    if (pthread_create (&r->threads[r->num_threads], NULL, reader_thread, r) != 0)
+      break;
+  if (! r->num_threads)
+    {
+      eit_reader_close (r);
+      errno = EAGAIN;
+      return NULL;
+    }
+  return r;
+}
+
+int eit_reader_next (struct eit_reader *r, const uint8_t **data, size_t *len)
+{
+  if (! r->use_uring)
+    pthread_mutex_lock (&r->lock);
+
+  // die zuletzt abgeholte Datei wird jetzt nicht mehr gebraucht
+  if (r->released < r->next)
+    {
+      struct s_slot *s = &r->slots[r->released % r->depth];
+      s->state = SLOT_FREE;
+      eit_file_release (&s->f);
+      r->released++;
+      if (! r->use_uring)
+        pthread_cond_broadcast (&r->slot_free);
+    }
+
+  if (r->next >= r->num_files)
+    {
+      if (! r->use_uring)
+        pthread_mutex_unlock (&r->lock);
+      errno = EINVAL;
+      return -1;
+    }
+
+  struct s_slot *s = &r->slots[r->next % r->depth];
+  if (r->use_uring)
+    {
+#ifdef HAVE_IO_URING
+      start_files (r);
+      uring_reap (r);
+      // nicht für jede Datei einzeln submitten, aber rechtzeitig, damit die Tiefe erhalten bleibt
+      if (r->ring.to_submit > r->depth / 8 && uring_enter (&r->ring, 0))
+        slot_done (s, errno);
+      while (s->state != SLOT_DONE)
+        {
+          if (uring_enter (&r->ring, 1))
+            {
+              slot_done (s, errno);
+              break;
+            }
+          uring_reap (r);
+        }
+#endif
+    }
+  else
+    {
+      while (s->state != SLOT_DONE || s->file != r->next)
+        pthread_cond_wait (&r->slot_done, &r->lock);
+      pthread_mutex_unlock (&r->lock);
+    }
+
+  r->next++;
+  if (s->err)
+    {
+      errno = s->err;
+      return -1;
+    }
+  *data = s->data;
+  *len = s->len;
+  return 0;
+}
+
+const char *eit_reader_backend (const struct eit_reader *r)
+{
+  return r->use_uring ? "io_uring" : "threads";
+}
+
+void eit_reader_close (struct eit_reader *r)
+{
+  if (! r)
+    return;
+
+  if (r->use_uring)
+    {
+#ifdef HAVE_IO_URING
+      // laufende Operationen abwarten, sie schreiben noch in die Puffer
+      while (r->busy && uring_enter (&r->ring, 1) == 0)
+        uring_reap (r);
+      uring_reap (r);
+      uring_free (&r->ring);
+#endif
+    }
+  else
+    {
+      pthread_mutex_lock (&r->lock);
+      r->stop = 1;
+      pthread_cond_broadcast (&r->slot_free);
+      pthread_mutex_unlock (&r->lock);
+      for (unsigned k = 0; k < r->num_threads; ++k)
+        pthread_join (r->threads[k], NULL);
+      pthread_cond_destroy (&r->slot_free);
+      pthread_cond_destroy (&r->slot_done);
+      pthread_mutex_destroy (&r->lock);
+    }
+
+  for (unsigned k = 0; k < r->depth; ++k)
+    {
+      if (r->slots[k].fd >= 0)
+        close (r->slots[k].fd);
+      free (r->slots[k].buf);
+      eit_file_free (&r->slots[k].f);
+    }
+  free (r->slots);
+  free (r);
+}
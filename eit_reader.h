@@ -0,0 +1,35 @@
+/*!
+  \file eit_reader.h
+
+  --prefetch: liest die .eit Dateien im Voraus, damit auf Netzlaufwerken
+  (NFS/SMB) nicht jedes open und read einzeln auf den Server wartet. Bis zu
+  depth Dateien sind gleichzeitig in Arbeit, über io_uring (openat, read und
+  close als asynchrone Operationen, direkt über die Syscalls ohne liburing)
+  oder, wenn der Kernel das nicht kann, mit einem Thread pro Datei im Flug.
+  Der Parser bekommt die Dateien trotzdem in der ursprünglichen Reihenfolge.
+*/
+
+#ifndef EIT_READER_H
+#define EIT_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct eit_reader;
+
+// files muss bis eit_reader_close gültig bleiben, Rückgabe NULL und errno bei Fehler
+struct eit_reader *eit_reader_open (const char **files, size_t num_files, unsigned depth);
+
+/*
+  Inhalt der nächsten Datei aus files, gültig bis zum nächsten Aufruf.
+  Rückgabe -1 und errno, wenn diese Datei nicht gelesen werden konnte,
+  der nächste Aufruf liefert dann die folgende Datei.
+*/
+int eit_reader_next (struct eit_reader *r, const uint8_t **data, size_t *len);
+
+// "io_uring" oder "threads"
+const char *eit_reader_backend (const struct eit_reader *r);
+
+void eit_reader_close (struct eit_reader *r);
+
+#endif
@@ -0,0 +1,154 @@
+/*!
+  \file eit_run_stats.c
+
+  --stats Zähler und deren JSON Ausgabe, siehe eit_run_stats.h
+*/
+
+#include <time.h>
+
+#include "eit_run_stats.h"
+#include "outbuf.h"
+
+uint64_t eit_run_stats_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void eit_run_stats_add (struct eit_run_stats *sum, const struct eit_run_stats *s)
+{
+  for (int k = 0; k < 256; ++k)
+    sum->lib.descriptors[k] += s->lib.descriptors[k];
+  for (int k = 0; k < 17; ++k)
+    sum->lib.extended_chains[k] += s->lib.extended_chains[k];
+  for (int k = 0; k < EIT_NUM_ERRORS; ++k)
+    sum->lib.errors[k] += s->lib.errors[k];
+
+  // die Namen sind Konstanten aus get_code_table, also in allen Threads dieselben Zeiger
+  for (int j = 0; j < s->lib.num_code_tables; ++j)
+    {
+      int k = 0;
+      while (k < sum->lib.num_code_tables && sum->lib.code_tables[k].code_table != s->lib.code_tables[j].code_table)
+        k++;
+      if (k == sum->lib.num_code_tables)
+        {
+          sum->lib.code_tables[k].code_table = s->lib.code_tables[j].code_table;
+          sum->lib.num_code_tables++;
+        }
+      sum->lib.code_tables[k].texts += s->lib.code_tables[j].texts;
+      sum->lib.code_tables[k].iconv += s->lib.code_tables[j].iconv;
+    }
+  sum->lib.decode_ns += s->lib.decode_ns;
+
+  sum->files += s->files;
+  sum->bytes += s->bytes;
+  sum->events += s->events;
+  sum->cache_hits += s->cache_hits;
+  sum->files_with_errors += s->files_with_errors;
+  for (int k = 0; k < EIT_NUM_STAGES; ++k)
+    sum->ns[k] += s->ns[k];
+}
+
+// Schlüssel für "errors", Index -enum eit_error
+static const char *error_names[EIT_NUM_ERRORS] =
+{
+  "ok", "truncated", "code_table", "iconv", "charset", "too_big",
+  "not_implemented", "unknown_descriptor", "nomem", "not_eit", "crc"
+};
+
+static void put_key (struct outbuf *b, const char *prefix, const char *key)
+{
+  outbuf_puts (b, prefix);
+  outbuf_putc (b, '"');
+  outbuf_put_json_escaped (b, key);
+  outbuf_puts (b, "\":");
+}
+
+static void put_ms (struct outbuf *b, const char *prefix, const char *key, uint64_t ns)
+{
+  char tmp[32];
+  put_key (b, prefix, key);
+  snprintf (tmp, sizeof (tmp), "%.3f", ns / 1e6);
+  outbuf_puts (b, tmp);
+}
+
+int eit_run_stats_write (FILE *f, const struct eit_run_stats *s, uint64_t wall_ns)
+{
+  struct outbuf b;
+  outbuf_init (&b);
+
+  outbuf_puts (&b, "{\"files\":");
+  outbuf_put_int (&b, s->files);
+  outbuf_puts (&b, ",\"bytes\":");
+  outbuf_put_int (&b, s->bytes);
+  outbuf_puts (&b, ",\"events\":");
+  outbuf_put_int (&b, s->events);
+  outbuf_puts (&b, ",\"cache_hits\":");
+  outbuf_put_int (&b, s->cache_hits);
+  outbuf_puts (&b, ",\"files_with_errors\":");
+  outbuf_put_int (&b, s->files_with_errors);
+
+  // descriptors: Descriptor-Schleife ohne die Textdekodierung
+  uint64_t parse = s->ns[EIT_STAGE_PARSE];
+  uint64_t decode = s->lib.decode_ns;
+  put_ms (&b, ",\"time_ms\":{", "wall", wall_ns);
+  put_ms (&b, ",", "read", s->ns[EIT_STAGE_READ]);
+  put_ms (&b, ",", "parse", parse);
+  put_ms (&b, ",", "descriptors", (parse > decode) ? parse - decode : 0);
+  put_ms (&b, ",", "decode", decode);
+  put_ms (&b, ",", "output", s->ns[EIT_STAGE_OUTPUT]);
+  put_ms (&b, ",", "write", s->ns[EIT_STAGE_WRITE]);
+  outbuf_putc (&b, '}');
+
+  outbuf_puts (&b, ",\"descriptors\":{");
+  const char *sep = "";
+  for (int k = 0; k < 256; ++k)
+    if (s->lib.descriptors[k])
+      {
+        char key[8];
+        snprintf (key, sizeof (key), "%#04x", k);
+        put_key (&b, sep, key);
+        outbuf_put_int (&b, s->lib.descriptors[k]);
+        sep = ",";
+      }
+
+  outbuf_puts (&b, "},\"extended_chains\":{");
+  sep = "";
+  for (int k = 0; k < 17; ++k)
+    if (s->lib.extended_chains[k])
+      {
+        char key[8];
+        snprintf (key, sizeof (key), "%i", k);
+        put_key (&b, sep, key);
+        outbuf_put_int (&b, s->lib.extended_chains[k]);
+        sep = ",";
+      }
+
+  outbuf_puts (&b, "},\"code_tables\":{");
+  for (int k = 0; k < s->lib.num_code_tables; ++k)
+    {
+      put_key (&b, k ? "," : "", s->lib.code_tables[k].code_table);
+      outbuf_puts (&b, "{\"texts\":");
+      outbuf_put_int (&b, s->lib.code_tables[k].texts);
+      outbuf_puts (&b, ",\"iconv\":");
+      outbuf_put_int (&b, s->lib.code_tables[k].iconv);
+      outbuf_putc (&b, '}');
+    }
+
+  outbuf_puts (&b, "},\"errors\":{");
+  sep = "";
+  for (int k = 1; k < EIT_NUM_ERRORS; ++k)
+    if (s->lib.errors[k])
+      {
+        put_key (&b, sep, error_names[k]);
+        outbuf_put_int (&b, s->lib.errors[k]);
+        sep = ",";
+      }
+  outbuf_putc (&b, '}');
+  outbuf_puts (&b, "}\n");
+
+  int ret = (b.failed || outbuf_flush (&b, f)) ? -1 : 0;
+  outbuf_free (&b);
+  return ret;
+}
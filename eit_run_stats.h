@@ -0,0 +1,45 @@
+/*!
+  \file eit_run_stats.h
+
+  --stats: Zähler und Zeiten eines parse_eit Laufs, am Ende als eine Zeile
+  JSON auf stderr. Bei -j hat jeder Thread eigene Zähler, die am Ende
+  addiert werden, die Zeiten der Stufen sind also über alle Threads summiert.
+*/
+
+#ifndef EIT_RUN_STATS_H
+#define EIT_RUN_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "parse_eit.h"
+
+enum eit_stage
+{
+  EIT_STAGE_READ,     // eit_file_load bzw. eit_stream_next
+  EIT_STAGE_PARSE,    // eit_parse*, enthält lib.decode_ns
+  EIT_STAGE_OUTPUT,   // Datensätze in den Ausgabepuffer
+  EIT_STAGE_WRITE,    // Ausgabepuffer nach stdout
+  EIT_NUM_STAGES
+};
+
+struct eit_run_stats
+{
+  struct eit_stats lib;     // Zähler aus dem eit_ctx
+  uint64_t files;
+  uint64_t bytes;           // .eit Dateien bzw. EIT sections
+  uint64_t events;
+  uint64_t cache_hits;
+  uint64_t files_with_errors;
+  uint64_t ns[EIT_NUM_STAGES];
+};
+
+// CLOCK_MONOTONIC in ns
+uint64_t eit_run_stats_now (void);
+
+void eit_run_stats_add (struct eit_run_stats *sum, const struct eit_run_stats *s);
+
+// wall_ns ist die Laufzeit des ganzen Programms, Rückgabe -1 bei Schreibfehler
+int eit_run_stats_write (FILE *f, const struct eit_run_stats *s, uint64_t wall_ns);
+
+#endif
@@ -0,0 +1,406 @@
+/*!
+  \file eit_serve.c
+
+  Unix Socket Server für --serve, siehe eit_serve.h
+
+  Ein Thread, level-triggered epoll. Die Anfragen eines Clients werden der
+  Reihe nach bearbeitet, solange seine noch nicht gesendete Antwort unter
+  SERVE_MAX_PENDING liegt, danach wird von ihm erst wieder gelesen, wenn
+  der Socket die Antwort abgenommen hat.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "eit_serve.h"
+
+// längste Anfragezeile (Pfad bzw. "@LÄNGE")
+#define SERVE_MAX_LINE 4096
+#define SERVE_MAX_PENDING (4 * 1024 * 1024)
+#define SERVE_READ_SIZE 65536
+#define SERVE_MAX_EVENTS 64
+
+struct s_client
+{
+  int fd;
+  uint8_t *in;        // empfangene, noch nicht bearbeitete Anfragen
+  size_t in_len;
+  size_t in_size;
+  struct outbuf out;
+  size_t sent;        // bereits gesendeter Teil von out
+  uint32_t events;    // aktuell bei epoll angemeldet
+  char eof;           // Client hat seine Seite geschlossen
+  char closing;       // Protokollfehler, nach dem Senden schließen
+
+  struct s_client *prev;
+  struct s_client *next;
+};
+
+struct s_server
+{
+  int epfd;
+  eit_serve_fn fn;
+  void *arg;
+  struct s_client *clients;
+};
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal (int sig)
+{
+  (void) sig;
+  s_stop = 1;
+}
+
+// antwortet noch ein Server an addr?
+static int socket_alive (const struct sockaddr_un *addr)
+{
+  int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return 0;
+  int alive = ! connect (fd, (const struct sockaddr *) addr, sizeof (*addr));
+  close (fd);
+  return alive;
+}
+
+static int open_socket (const char *path)
+{
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  strcpy (addr.sun_path, path);
+
+  int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  int r = bind (fd, (struct sockaddr *) &addr, sizeof (addr));
+  if (r && errno == EADDRINUSE)
+    {
+      if (socket_alive (&addr))
+        errno = EADDRINUSE;   // von connect überschrieben
+      else
+        {
+          unlink (path);
+          r = bind (fd, (struct sockaddr *) &addr, sizeof (addr));
+        }
+    }
+
+  if (r || listen (fd, SOMAXCONN))
+    {
+      int e = errno;
+      close (fd);
+      errno = e;
+      return -1;
+    }
+  return fd;
+}
+
+static void close_client (struct s_server *srv, struct s_client *c)
+{
+  if (c->prev)
+    c->prev->next = c->next;
+  else
+    srv->clients = c->next;
+  if (c->next)
+    c->next->prev = c->prev;
+
+  close (c->fd);
+  free (c->in);
+  outbuf_free (&c->out);
+  free (c);
+}
+
+static void accept_clients (struct s_server *srv, int lfd)
+{
+  for (;;)
+    {
+      int fd = accept4 (lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+        {
+          if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            perror ("accept4");
+          return;
+        }
+
+      struct s_client *c = calloc (1, sizeof (*c));
+      struct epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.ptr = c;
+      if (! c || epoll_ctl (srv->epfd, EPOLL_CTL_ADD, fd, &ev))
+        {
+          perror ("accept client");
+          free (c);
+          close (fd);
+          continue;
+        }
+      c->fd = fd;
+      c->events = EPOLLIN;
+      outbuf_init (&c->out);
+
+      c->next = srv->clients;
+      if (c->next)
+        c->next->prev = c;
+      srv->clients = c;
+    }
+}
+
+static size_t pending (const struct s_client *c)
+{
+  return c->out.len - c->sent;
+}
+
+// Fehler im Protokoll: Meldung als letzte Antwort, danach wird die Verbindung geschlossen
+static void protocol_error (struct s_client *c, const char *msg)
+{
+  outbuf_puts (&c->out, "{\"error\":\"");
+  outbuf_put_json_escaped (&c->out, msg);
+  outbuf_puts (&c->out, "\"}\n\n");
+  c->closing = 1;
+}
+
+// "@LÄNGE" ohne Vorzeichen und Leerzeichen, Rückgabe -1 wenn ungültig oder zu groß
+static long parse_length (const uint8_t *p, size_t len)
+{
+  if (len < 1 || len > 9)
+    return -1;
+  long n = 0;
+  for (size_t k = 0; k < len; ++k)
+    {
+      if (p[k] < '0' || p[k] > '9')
+        return -1;
+      n = 10 * n + p[k] - '0';
+    }
+  return (n <= EIT_SERVE_MAX_DATA)? n : -1;
+}
+
+/*
+  Bearbeitet alle vollständigen Anfragen in c->in. Rückgabe 1, wenn wegen
+  SERVE_MAX_PENDING aufgehört wurde und noch Anfragen warten können.
+*/
+static int process_requests (struct s_server *srv, struct s_client *c)
+{
+  size_t pos = 0;
+  int more = 0;
+
+  while (! c->closing)
+    {
+      if (pending (c) >= SERVE_MAX_PENDING)
+        {
+          more = 1;
+          break;
+        }
+
+      uint8_t *line = c->in + pos;
+      size_t avail = c->in_len - pos;
+      uint8_t *nl = memchr (line, '\n', avail);
+      if (! nl)
+        {
+          if (avail > SERVE_MAX_LINE)
+            protocol_error (c, "request line too long");
+          break;
+        }
+
+      size_t header = nl + 1 - line;
+      size_t line_len = nl - line;
+      if (line_len && line[line_len - 1] == '\r')
+        line_len--;
+
+      if (line_len && line[0] == '@')
+        {
+          long n = parse_length (line + 1, line_len - 1);
+          if (n < 0)
+            {
+              protocol_error (c, "invalid data length");
+              break;
+            }
+          // Rest der Daten kommt noch
+          if (avail - header < (size_t) n)
+            break;
+
+          srv->fn (srv->arg, NULL, nl + 1, n, &c->out);
+          outbuf_putc (&c->out, '\n');
+          pos += header + n;
+        }
+      else
+        {
+          if (line_len)
+            {
+              line[line_len] = 0;
+              srv->fn (srv->arg, (const char *) line, NULL, 0, &c->out);
+              outbuf_putc (&c->out, '\n');
+            }
+          pos += header;
+        }
+
+      if (c->out.failed)
+        {
+          outbuf_free (&c->out);
+          c->sent = 0;
+          protocol_error (c, "out of memory");
+        }
+    }
+
+  memmove (c->in, c->in + pos, c->in_len - pos);
+  c->in_len -= pos;
+  return more;
+}
+
+// sendet so viel wie möglich, Rückgabe -1 wenn die Verbindung weg ist
+static int flush_client (struct s_client *c)
+{
+  while (pending (c))
+    {
+      ssize_t n = send (c->fd, c->out.data + c->sent, pending (c), MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+      if (n < 0)
+        return -1;
+      c->sent += n;
+    }
+  c->out.len = 0;
+  c->sent = 0;
+  return 0;
+}
+
+static int receive (struct s_client *c)
+{
+  if (c->in_size - c->in_len < SERVE_READ_SIZE)
+    {
+      size_t size = c->in_size ? 2 * c->in_size : 2 * SERVE_READ_SIZE;
+      uint8_t *tmp = realloc (c->in, size);
+      if (! tmp)
+        return -1;
+      c->in = tmp;
+      c->in_size = size;
+    }
+
+  ssize_t n = recv (c->fd, c->in + c->in_len, c->in_size - c->in_len, 0);
+  if (n > 0)
+    c->in_len += n;
+  else if (n == 0)
+    c->eof = 1;
+  else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    return -1;
+  return 0;
+}
+
+// Rückgabe -1: Client schließen
+static int handle_client (struct s_server *srv, struct s_client *c, uint32_t events)
+{
+  if (events & EPOLLERR)
+    return -1;
+  if ((events & (EPOLLIN | EPOLLHUP)) && ! c->eof && receive (c))
+    return -1;
+
+  while (process_requests (srv, c))
+    {
+      if (flush_client (c))
+        return -1;
+      if (pending (c))
+        break;
+    }
+  if (flush_client (c))
+    return -1;
+
+  if ((c->eof || c->closing) && ! pending (c))
+    return -1;
+
+  uint32_t want = 0;
+  if (! c->eof && ! c->closing && pending (c) < SERVE_MAX_PENDING)
+    want |= EPOLLIN;
+  if (pending (c))
+    want |= EPOLLOUT;
+  if (want != c->events)
+    {
+      struct epoll_event ev;
+      ev.events = want;
+      ev.data.ptr = c;
+      if (epoll_ctl (srv->epfd, EPOLL_CTL_MOD, c->fd, &ev))
+        return -1;
+      c->events = want;
+    }
+  return 0;
+}
+
+int eit_serve (const char *sock_path, eit_serve_fn fn, void *arg)
+{
+  struct s_server srv;
+  srv.fn = fn;
+  srv.arg = arg;
+  srv.clients = NULL;
+
+  int lfd = open_socket (sock_path);
+  if (lfd < 0)
+    return -1;
+
+  srv.epfd = epoll_create1 (EPOLL_CLOEXEC);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;   // NULL = listen socket
+  if (srv.epfd < 0 || epoll_ctl (srv.epfd, EPOLL_CTL_ADD, lfd, &ev))
+    {
+      int e = errno;
+      if (srv.epfd >= 0)
+        close (srv.epfd);
+      close (lfd);
+      unlink (sock_path);
+      errno = e;
+      return -1;
+    }
+
+  // ohne SA_RESTART, damit epoll_wait mit EINTR zurückkommt
+  struct sigaction sa;
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = on_signal;
+  sigemptyset (&sa.sa_mask);
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+  signal (SIGPIPE, SIG_IGN);
+
+  fprintf (stderr, "listening on %s\n", sock_path);
+
+  struct epoll_event events[SERVE_MAX_EVENTS];
+  while (! s_stop)
+    {
+      int n = epoll_wait (srv.epfd, events, SERVE_MAX_EVENTS, -1);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        {
+          perror ("epoll_wait");
+          break;
+        }
+
+      for (int k = 0; k < n; ++k)
+        {
+          struct s_client *c = events[k].data.ptr;
+          if (! c)
+            accept_clients (&srv, lfd);
+          else if (handle_client (&srv, c, events[k].events))
+            close_client (&srv, c);
+        }
+    }
+
+  while (srv.clients)
+    close_client (&srv, srv.clients);
+  close (srv.epfd);
+  close (lfd);
+  unlink (sock_path);
+  return 0;
+}
@@ -0,0 +1,44 @@
+/*!
+  \file eit_serve.h
+
+  --serve SOCKET: parse_eit läuft als Dienst an einem Unix Socket, damit
+  einzelne Aufnahmen ohne Programmstart geparst werden können. Alle Clients
+  werden in einer epoll Schleife bedient, geparst wird immer mit demselben
+  eit_ctx (iconv descriptors und Arena bleiben erhalten).
+
+  Protokoll, je Anfrage eine Zeile:
+
+    PFAD\n              Datei PFAD parsen (wie auf der Kommandozeile)
+    @LÄNGE\n DATEN      LÄNGE Byte einer .eit Datei direkt mitschicken
+    ?VON BIS\n          gespeicherte Events mit VON <= start_time_unix < BIS
+                        (siehe eit_store.h, Pfade mit '?' am Anfang als ./?...)
+
+  Die Antwort sind die ndjson Datensätze der Anfrage, abgeschlossen mit
+  einer Leerzeile. Leere Anfragezeilen werden ignoriert.
+*/
+
+#ifndef EIT_SERVE_H
+#define EIT_SERVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "outbuf.h"
+
+// höchstens so viele Byte nach '@'
+#define EIT_SERVE_MAX_DATA (16 * 1024 * 1024)
+
+/*
+  Bearbeitet eine Anfrage und hängt die Antwort an out an, entweder path
+  (null-terminiert) oder data/len ist gesetzt.
+*/
+typedef void (*eit_serve_fn) (void *arg, const char *path, const uint8_t *data, size_t len, struct outbuf *out);
+
+/*
+  Legt den Socket an (ein verwaister Socket eines beendeten Servers wird
+  ersetzt) und bedient Clients bis SIGINT oder SIGTERM. Rückgabe 0, oder -1
+  und errno wenn der Socket nicht angelegt werden konnte.
+*/
+int eit_serve (const char *sock_path, eit_serve_fn fn, void *arg);
+
+#endif
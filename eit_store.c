@@ -0,0 +1,384 @@
+/*!
+  \file eit_store.c
+
+  Events im Speicher für --serve, siehe eit_store.h
+
+  Strings stehen null-terminiert hintereinander in pool, eine Spalte mit
+  Strings enthält den Offset in pool (STORE_NONE für NULL). Gleiche Strings
+  werden über eine Hashtabelle nur einmal abgelegt, auch zwischen
+  verschiedenen Spalten. Beim Entfernen von Events bleiben ihre Strings im
+  Pool, sie werden beim nächsten Einlesen derselben Datei wiederverwendet.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "eit_store.h"
+#include "eit_token.h"
+
+#define STORE_NONE 0xFFFFFFFFu
+
+struct eit_store
+{
+  size_t num_events;
+  size_t max_events;
+
+  // Spalten mit je max_events Einträgen
+  uint32_t *filename;
+  uint8_t *table_id;            // 0 bei .eit Dateien, dann ohne die anderen Felder der section
+  uint16_t *service_id;
+  uint16_t *transport_stream_id;
+  uint16_t *original_network_id;
+  uint8_t *version_number;
+  uint8_t *section_number;
+  uint16_t *event_id;
+  int64_t *start_time;          // unix_time, INT64_MIN wenn undefiniert
+  uint32_t *start_clock;        // Uhrzeit der start_time als hour << 16 | minute << 8 | second
+  uint32_t *duration;           // ebenso
+  uint8_t *running_status;
+  uint8_t *free_CA_mode;
+  uint32_t *language;           // STORE_NONE ohne short_event_descriptor
+  uint32_t *event_name;
+  uint32_t *text;
+
+  // Events nach start_time, gleiche start_time in der Reihenfolge des Einfügens
+  uint32_t *by_start;
+  char sorted;
+
+  char *pool;
+  size_t pool_len;
+  size_t pool_size;
+
+  // Offset + 1 in pool, 0 = frei
+  uint32_t *slots;
+  size_t num_slots;           // Zweierpotenz
+  size_t num_strings;
+};
+
+// alle Spalten, für Vergrößern, Verschieben und Freigeben, by_start als letzte
+#define NUM_STORE_COLUMNS 17
+
+static void get_columns (struct eit_store *s, void ***cols, size_t *sizes)
+{
+  void **c[NUM_STORE_COLUMNS] =
+  {
+    (void **) &s->filename, (void **) &s->table_id, (void **) &s->service_id,
+    (void **) &s->transport_stream_id, (void **) &s->original_network_id, (void **) &s->version_number,
+    (void **) &s->section_number, (void **) &s->event_id, (void **) &s->start_time,
+    (void **) &s->start_clock, (void **) &s->duration, (void **) &s->running_status,
+    (void **) &s->free_CA_mode, (void **) &s->language, (void **) &s->event_name,
+    (void **) &s->text, (void **) &s->by_start
+  };
+  const size_t n[NUM_STORE_COLUMNS] =
+  {
+    sizeof (*s->filename), sizeof (*s->table_id), sizeof (*s->service_id),
+    sizeof (*s->transport_stream_id), sizeof (*s->original_network_id), sizeof (*s->version_number),
+    sizeof (*s->section_number), sizeof (*s->event_id), sizeof (*s->start_time),
+    sizeof (*s->start_clock), sizeof (*s->duration), sizeof (*s->running_status),
+    sizeof (*s->free_CA_mode), sizeof (*s->language), sizeof (*s->event_name),
+    sizeof (*s->text), sizeof (*s->by_start)
+  };
+  memcpy (cols, c, sizeof (c));
+  memcpy (sizes, n, sizeof (n));
+}
+
+struct eit_store *eit_store_new (void)
+{
+  return calloc (1, sizeof (struct eit_store));
+}
+
+static int grow_columns (struct eit_store *s)
+{
+  void **cols[NUM_STORE_COLUMNS];
+  size_t sizes[NUM_STORE_COLUMNS];
+  get_columns (s, cols, sizes);
+
+  // bei Speichermangel bleiben die schon vergrößerten Spalten so, max_events gilt weiter
+  size_t max = s->max_events ? 2 * s->max_events : 4096;
+  for (int k = 0; k < NUM_STORE_COLUMNS; ++k)
+    {
+      void *tmp = realloc (*cols[k], max * sizes[k]);
+      if (! tmp)
+        return -1;
+      *cols[k] = tmp;
+    }
+  s->max_events = max;
+  return 0;
+}
+
+static int grow_slots (struct eit_store *s)
+{
+  size_t size = s->num_slots ? 2 * s->num_slots : 4096;
+  uint32_t *slots = calloc (size, sizeof (uint32_t));
+  if (! slots)
+    return -1;
+  for (size_t k = 0; k < s->num_slots; ++k)
+    if (s->slots[k])
+      {
+        const char *str = s->pool + s->slots[k] - 1;
+        size_t pos = eit_token_hash (str, strlen (str)) & (size - 1);
+        while (slots[pos])
+          pos = (pos + 1) & (size - 1);
+        slots[pos] = s->slots[k];
+      }
+  free (s->slots);
+  s->slots = slots;
+  s->num_slots = size;
+  return 0;
+}
+
+/*
+  Offset von str in pool, neue Strings werden angehängt. Mit add == 0 wird nur
+  gesucht, Rückgabe dann STORE_NONE wenn str nicht vorkommt. Rückgabe -1 bei Speichermangel.
+*/
+static int64_t intern (struct eit_store *s, const char *str, char add)
+{
+  if (! str)
+    return STORE_NONE;
+  if (2 * (s->num_strings + 1) > s->num_slots && grow_slots (s))
+    return -1;
+
+  size_t len = strlen (str);
+  size_t pos = eit_token_hash (str, len) & (s->num_slots - 1);
+  while (s->slots[pos])
+    {
+      const char *p = s->pool + s->slots[pos] - 1;
+      if (! memcmp (p, str, len + 1))
+        return s->slots[pos] - 1;
+      pos = (pos + 1) & (s->num_slots - 1);
+    }
+  if (! add)
+    return STORE_NONE;
+
+  // Offset + 1 muss in uint32_t passen
+  if (s->pool_len + len + 1 >= STORE_NONE)
+    return -1;
+  if (s->pool_size - s->pool_len < len + 1)
+    {
+      size_t size = s->pool_size ? 2 * s->pool_size : 65536;
+      while (size - s->pool_len < len + 1)
+        size *= 2;
+      char *tmp = realloc (s->pool, size);
+      if (! tmp)
+        return -1;
+      s->pool = tmp;
+      s->pool_size = size;
+    }
+
+  uint32_t off = s->pool_len;
+  memcpy (s->pool + off, str, len + 1);
+  s->pool_len += len + 1;
+  s->slots[pos] = off + 1;
+  s->num_strings++;
+  return off;
+}
+
+static uint32_t pack_clock (const struct eit_duration *d)
+{
+  return (uint32_t) d->hour << 16 | d->minute << 8 | d->second;
+}
+
+static void unpack_clock (uint32_t v, struct eit_duration *d)
+{
+  d->hour = v >> 16;
+  d->minute = (v >> 8) & 0xFF;
+  d->second = v & 0xFF;
+}
+
+int eit_store_add (struct eit_store *s, const char *fn, const struct eit_section *sec, const struct eit_event *ev)
+{
+  if (s->num_events == s->max_events && (s->max_events >= UINT32_MAX / 2 || grow_columns (s)))
+    return -1;
+
+  const struct eit_short_event *se = ev->num_short_events ? &ev->short_events[0] : NULL;
+  int64_t fn_off = intern (s, fn, 1);
+  int64_t lang_off = intern (s, se ? se->language : NULL, 1);
+  int64_t name_off = intern (s, se ? se->event_name : NULL, 1);
+  int64_t text_off = intern (s, se ? se->text : NULL, 1);
+  if (fn_off < 0 || lang_off < 0 || name_off < 0 || text_off < 0)
+    return -1;
+
+  size_t k = s->num_events;
+  s->filename[k] = fn_off;
+  s->table_id[k] = sec ? sec->table_id : 0;
+  s->service_id[k] = sec ? sec->service_id : 0;
+  s->transport_stream_id[k] = sec ? sec->transport_stream_id : 0;
+  s->original_network_id[k] = sec ? sec->original_network_id : 0;
+  s->version_number[k] = sec ? sec->version_number : 0;
+  s->section_number[k] = sec ? sec->section_number : 0;
+  s->event_id[k] = ev->event_id;
+  s->start_time[k] = ev->start_time.undefined ? INT64_MIN : ev->start_time.unix_time;
+  s->start_clock[k] = pack_clock (&ev->start_time.t);
+  s->duration[k] = pack_clock (&ev->duration);
+  s->running_status[k] = ev->running_status;
+  s->free_CA_mode[k] = ev->free_CA_mode;
+  s->language[k] = se ? lang_off : STORE_NONE;
+  s->event_name[k] = name_off;
+  s->text[k] = text_off;
+
+  // meist kommen die Events schon in zeitlicher Reihenfolge, dann bleibt der Index sortiert
+  if (! k || (s->sorted && s->start_time[s->by_start[k - 1]] <= s->start_time[k]))
+    s->sorted = 1;
+  else
+    s->sorted = 0;
+  s->by_start[k] = k;
+  s->num_events++;
+  return 0;
+}
+
+void eit_store_remove_file (struct eit_store *s, const char *fn)
+{
+  int64_t off = intern (s, fn, 0);
+  if (off < 0 || off == STORE_NONE)
+    return;
+
+  void **cols[NUM_STORE_COLUMNS];
+  size_t sizes[NUM_STORE_COLUMNS];
+  get_columns (s, cols, sizes);
+
+  // Zeilen der Datei überspringen, alle anderen in allen Spalten nach vorn schieben
+  size_t n = 0;
+  for (size_t k = 0; k < s->num_events; ++k)
+    {
+      if (s->filename[k] == off)
+        continue;
+      if (n != k)
+        for (int c = 0; c < NUM_STORE_COLUMNS - 1; ++c)
+          memcpy ((char *) *cols[c] + n * sizes[c], (char *) *cols[c] + k * sizes[c], sizes[c]);
+      n++;
+    }
+  if (n == s->num_events)
+    return;
+
+  s->num_events = n;
+  for (size_t k = 0; k < n; ++k)
+    s->by_start[k] = k;
+  s->sorted = 0;
+}
+
+static int cmp_start (const void *a, const void *b, void *arg)
+{
+  const int64_t *start_time = arg;
+  uint32_t i = *(const uint32_t *) a, j = *(const uint32_t *) b;
+  if (start_time[i] != start_time[j])
+    return (start_time[i] < start_time[j]) ? -1 : 1;
+  return (i < j) ? -1 : (i > j);
+}
+
+// erster Eintrag in by_start mit start_time >= t
+static size_t lower_bound (const struct eit_store *s, int64_t t)
+{
+  size_t lo = 0, hi = s->num_events;
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (s->start_time[s->by_start[mid]] < t)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+static void put_stored_event (const struct eit_store *s, size_t k, enum output_format fmt,
+                              unsigned fields, struct outbuf *out)
+{
+  struct eit_section sec;
+  memset (&sec, 0, sizeof (sec));
+  sec.table_id = s->table_id[k];
+  sec.service_id = s->service_id[k];
+  sec.transport_stream_id = s->transport_stream_id[k];
+  sec.original_network_id = s->original_network_id[k];
+  sec.version_number = s->version_number[k];
+  sec.section_number = s->section_number[k];
+
+  struct eit_event ev;
+  memset (&ev, 0, sizeof (ev));
+  ev.event_id = s->event_id[k];
+  if (s->start_time[k] == INT64_MIN)
+    ev.start_time.undefined = 1;
+  else
+    {
+      // das Datum aus unix_time ohne die Uhrzeit, die Uhrzeit wie gespeichert (auch ungültiges BCD)
+      struct eit_start_time *st = &ev.start_time;
+      unpack_clock (s->start_clock[k], &st->t);
+      st->unix_time = s->start_time[k];
+      time_t day = st->unix_time - (st->t.hour * 3600 + st->t.minute * 60 + st->t.second);
+      struct tm tm;
+      gmtime_r (&day, &tm);
+      st->Y = tm.tm_year;
+      st->M = tm.tm_mon + 1;
+      st->D = tm.tm_mday;
+    }
+  unpack_clock (s->duration[k], &ev.duration);
+  ev.running_status = s->running_status[k];
+  ev.free_CA_mode = s->free_CA_mode[k];
+
+  struct eit_short_event se;
+  if (s->language[k] != STORE_NONE)
+    {
+      strncpy (se.language, s->pool + s->language[k], sizeof (se.language) - 1);
+      se.language[sizeof (se.language) - 1] = 0;
+      se.event_name = (s->event_name[k] == STORE_NONE) ? NULL : s->pool + s->event_name[k];
+      se.text = (s->text[k] == STORE_NONE) ? NULL : s->pool + s->text[k];
+      ev.short_events = &se;
+      ev.num_short_events = 1;
+    }
+
+  const char *fn = s->pool + s->filename[k];
+  if (fmt == OUTPUT_JSON)
+    output_json_head (out, fn, sec.table_id ? &sec : NULL);
+  output_event (out, fmt, fields, fn, sec.table_id ? &sec : NULL, &ev, NULL);
+}
+
+long eit_store_query (struct eit_store *s, int64_t from, int64_t to, enum output_format fmt,
+                      unsigned fields, struct outbuf *out)
+{
+  if (! s->sorted)
+    {
+      qsort_r (s->by_start, s->num_events, sizeof (uint32_t), cmp_start, s->start_time);
+      s->sorted = 1;
+    }
+
+  fields &= EIT_FIELD_EVENT_ID | EIT_FIELD_START_TIME | EIT_FIELD_DURATION | EIT_FIELD_RUNNING_STATUS
+            | EIT_FIELD_FREE_CA_MODE | EIT_FIELD_EVENT_NAME | EIT_FIELD_TEXT;
+  long num = 0;
+  for (size_t k = lower_bound (s, from); k < s->num_events && s->start_time[s->by_start[k]] < to; ++k)
+    {
+      put_stored_event (s, s->by_start[k], fmt, fields, out);
+      num++;
+    }
+  return out->failed ? -1 : num;
+}
+
+size_t eit_store_num_events (const struct eit_store *s)
+{
+  return s->num_events;
+}
+
+size_t eit_store_memory (const struct eit_store *s)
+{
+  void **cols[NUM_STORE_COLUMNS];
+  size_t sizes[NUM_STORE_COLUMNS];
+  get_columns ((struct eit_store *) s, cols, sizes);
+  size_t row = 0;
+  for (int k = 0; k < NUM_STORE_COLUMNS; ++k)
+    row += sizes[k];
+  return sizeof (*s) + s->max_events * row + s->pool_size + s->num_slots * sizeof (uint32_t);
+}
+
+void eit_store_free (struct eit_store *s)
+{
+  if (! s)
+    return;
+  void **cols[NUM_STORE_COLUMNS];
+  size_t sizes[NUM_STORE_COLUMNS];
+  get_columns (s, cols, sizes);
+  for (int k = 0; k < NUM_STORE_COLUMNS; ++k)
+    free (*cols[k]);
+  free (s->pool);
+  free (s->slots);
+  free (s);
+}
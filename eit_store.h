@@ -0,0 +1,47 @@
+/*!
+  \file eit_store.h
+
+  --serve SOCKET -r DIR: die Events des ganzen Archivs bleiben im Speicher,
+  damit Anfragen nach einem Zeitraum ohne erneutes Parsen beantwortet
+  werden können. Die Events liegen spaltenweise (struct of arrays) mit
+  festen Breiten, alle Strings einmal in einem gemeinsamen Pool: die vielen
+  gleichen Titel einer Serie und die Sprachcodes kosten je Event nur einen
+  uint32_t. Für Abfragen gibt es einen nach start_time sortierten Index.
+
+  Gespeichert werden die Kopfdaten des Events und der section sowie der
+  erste short_event_descriptor (wie bei --export).
+*/
+
+#ifndef EIT_STORE_H
+#define EIT_STORE_H
+
+#include "parse_eit.h"
+#include "outbuf.h"
+#include "eit_output.h"
+
+struct eit_store;
+
+struct eit_store *eit_store_new (void);
+
+// sec ist NULL bei .eit Dateien, Rückgabe -1 bei Speichermangel
+int eit_store_add (struct eit_store *s, const char *fn, const struct eit_section *sec, const struct eit_event *ev);
+
+// entfernt alle Events aus fn, z.B. bevor die Datei neu eingelesen wird
+void eit_store_remove_file (struct eit_store *s, const char *fn);
+
+/*
+  Schreibt alle Events mit from <= start_time_unix < to aufsteigend nach
+  start_time als Datensätze im Format fmt nach out, von fields (enum eit_field)
+  nur die gespeicherten Felder. Rückgabe Anzahl der Events, -1 bei Speichermangel.
+*/
+long eit_store_query (struct eit_store *s, int64_t from, int64_t to, enum output_format fmt,
+                      unsigned fields, struct outbuf *out);
+
+size_t eit_store_num_events (const struct eit_store *s);
+
+// belegter Speicher in Byte
+size_t eit_store_memory (const struct eit_store *s);
+
+void eit_store_free (struct eit_store *s);
+
+#endif
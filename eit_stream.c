@@ -0,0 +1,349 @@
+/*!
+  \file eit_stream.c
+
+  EIT sections aus section dumps und Transport Streams, siehe eit_stream.h
+
+  Referenz für den Transport Stream ist ISO/IEC 13818-1, 2.4.3 (Pakete) und
+  2.4.4 (sections, pointer_field).
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "eit_stream.h"
+
+#define READ_SIZE (256 * 1024)
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define EIT_PID 0x12
+
+// 3 Byte bis einschließlich section_length + section_length
+static inline size_t section_total (const uint8_t *p)
+{
+  return 3 + (size_t) ((p[1] & 0x0F) << 8 | p[2]);
+}
+
+struct s_seen_section
+{
+  uint64_t key;     // 0 = frei
+  uint8_t version_number;
+};
+
+int eit_stream_open (struct eit_stream *s, const char *fn, enum eit_stream_type type)
+{
+  memset (s, 0, sizeof (*s));
+  s->type = type;
+  s->cc = -1;
+
+  s->buf = malloc (READ_SIZE);
+  if (! s->buf)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+  s->fd = open (fn, O_RDONLY | O_CLOEXEC);
+  if (s->fd < 0)
+    {
+      int err = errno;
+      free (s->buf);
+      s->buf = NULL;
+      errno = err;
+      return -1;
+    }
+  return 0;
+}
+
+void eit_stream_close (struct eit_stream *s)
+{
+  if (s->fd >= 0)
+    close (s->fd);
+  free (s->buf);
+  free (s->seen);
+  memset (s, 0, sizeof (*s));
+  s->fd = -1;
+}
+
+// sorgt dafür, dass n Byte ab pos im Puffer liegen, Rückgabe die Anzahl vorhandener Bytes oder -1
+static ssize_t fill (struct eit_stream *s, size_t n)
+{
+  if (s->len - s->pos >= n || s->eof)
+    return s->len - s->pos;
+
+  memmove (s->buf, s->buf + s->pos, s->len - s->pos);
+  s->len -= s->pos;
+  s->pos = 0;
+
+  while (s->len < n && ! s->eof)
+    {
+      ssize_t r = read (s->fd, s->buf + s->len, READ_SIZE - s->len);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r < 0)
+        return -1;
+      if (r == 0)
+        s->eof = 1;
+      s->len += r;
+    }
+  return s->len;
+}
+
+static int next_raw_section (struct eit_stream *s, const uint8_t **sec, size_t *len)
+{
+  for (;;)
+    {
+      if (fill (s, 3) < 0)
+        return -1;
+
+      // stuffing zwischen den sections
+      while (s->pos < s->len && s->buf[s->pos] == 0xFF)
+        s->pos++;
+      if (s->len - s->pos >= 3)
+        break;
+      if (s->eof)
+        {
+          if (s->pos < s->len)
+            s->num_dropped++;
+          s->pos = s->len;
+          return 0;
+        }
+    }
+
+  const uint8_t *p = s->buf + s->pos;
+  size_t total = section_total (p);
+  ssize_t n = fill (s, total);
+  if (n < 0)
+    return -1;
+  if ((size_t) n < total)
+    {
+      // am Ende abgeschnitten
+      s->num_dropped++;
+      s->pos = s->len;
+      return 0;
+    }
+
+  *sec = s->buf + s->pos;
+  *len = total;
+  s->pos += total;
+  return 1;
+}
+
+// nächstes Paket der PID 0x12 mit Nutzdaten, Rückgabe 1, 0 am Ende oder -1
+static int next_ts_packet (struct eit_stream *s)
+{
+  for (;;)
+    {
+      ssize_t n = fill (s, TS_PACKET_SIZE);
+      if (n < 0)
+        return -1;
+      if (n < TS_PACKET_SIZE)
+        {
+          s->pos = s->len;
+          return 0;
+        }
+
+      const uint8_t *p = s->buf + s->pos;
+      if (p[0] != TS_SYNC_BYTE)
+        {
+          // Synchronisation verloren: bis zum nächsten sync_byte weitersuchen
+          const uint8_t *sync = memchr (p + 1, TS_SYNC_BYTE, s->len - s->pos - 1);
+          s->pos = sync ? (size_t) (sync - s->buf) : s->len;
+          s->num_sync_errors++;
+          s->in_section = 0;
+          s->cc = -1;
+          continue;
+        }
+
+      s->pos += TS_PACKET_SIZE;
+      s->num_packets++;
+
+      int transport_error_indicator = p[1] >> 7;
+      int payload_unit_start_indicator = (p[1] >> 6) & 0x01;
+      int pid = (p[1] & 0x1F) << 8 | p[2];
+      int adaptation_field_control = (p[3] >> 4) & 0x03;
+      int continuity_counter = p[3] & 0x0F;
+
+      if (pid != EIT_PID)
+        continue;
+
+      if (transport_error_indicator)
+        {
+          s->in_section = 0;
+          s->cc = -1;
+          continue;
+        }
+
+      // ohne payload wird der continuity_counter nicht erhöht
+      if (! (adaptation_field_control & 0x01))
+        continue;
+
+      if (s->cc >= 0 && continuity_counter == s->cc)
+        continue;   // doppelt gesendetes Paket
+      if (s->cc >= 0 && continuity_counter != ((s->cc + 1) & 0x0F))
+        {
+          s->num_discontinuities++;
+          if (s->in_section && s->section_len)
+            s->num_dropped++;
+          s->in_section = 0;
+        }
+      s->cc = continuity_counter;
+
+      const uint8_t *payload = p + 4;
+      const uint8_t *end = p + TS_PACKET_SIZE;
+      if (adaptation_field_control & 0x02)
+        payload += 1 + p[4];
+      if (payload >= end)
+        continue;
+
+      s->new_section = NULL;
+      if (payload_unit_start_indicator)
+        {
+          size_t pointer_field = *(payload++);
+          if (payload + pointer_field >= end)
+            {
+              s->in_section = 0;
+              continue;
+            }
+          s->new_section = payload + pointer_field;
+        }
+
+      s->payload = payload;
+      s->payload_end = end;
+      return 1;
+    }
+}
+
+// kopiert Bytes aus dem aktuellen Paket bis end in die section, Rückgabe 1 wenn sie vollständig ist
+static int feed_section (struct eit_stream *s, const uint8_t *end)
+{
+  while (s->payload < end)
+    {
+      // stuffing nach der letzten section eines Pakets
+      if (! s->section_len && *s->payload == 0xFF)
+        {
+          s->payload = end;
+          s->in_section = 0;
+          return 0;
+        }
+
+      size_t total = (s->section_len >= 3)? section_total (s->section) : 3;
+
+      size_t n = end - s->payload;
+      if (n > total - s->section_len)
+        n = total - s->section_len;
+      memcpy (s->section + s->section_len, s->payload, n);
+      s->section_len += n;
+      s->payload += n;
+
+      if (s->section_len >= 3 && s->section_len == section_total (s->section))
+        return 1;
+    }
+  return 0;
+}
+
+static int next_ts_section (struct eit_stream *s, const uint8_t **sec, size_t *len)
+{
+  for (;;)
+    {
+      if (s->section_done)
+        {
+          s->section_done = 0;
+          s->section_len = 0;
+        }
+
+      if (s->payload < s->payload_end)
+        {
+          // Rest der laufenden section bis zum Beginn der neuen
+          if (s->new_section)
+            {
+              if (s->in_section && feed_section (s, s->new_section))
+                {
+                  s->section_done = 1;
+                  *sec = s->section;
+                  *len = s->section_len;
+                  return 1;
+                }
+              if (s->in_section && s->section_len)
+                s->num_dropped++;
+
+              s->payload = s->new_section;
+              s->new_section = NULL;
+              s->section_len = 0;
+              s->in_section = 1;
+            }
+
+          if (s->in_section && feed_section (s, s->payload_end))
+            {
+              s->section_done = 1;
+              *sec = s->section;
+              *len = s->section_len;
+              return 1;
+            }
+          s->payload = s->payload_end;
+        }
+
+      int r = next_ts_packet (s);
+      if (r <= 0)
+        {
+          if (s->in_section && s->section_len)
+            s->num_dropped++;
+          s->in_section = 0;
+          return r;
+        }
+    }
+}
+
+int eit_stream_next (struct eit_stream *s, const uint8_t **sec, size_t *len)
+{
+  if (s->type == EIT_STREAM_TS)
+    return next_ts_section (s, sec, len);
+  return next_raw_section (s, sec, len);
+}
+
+static uint64_t section_key (const struct eit_section *sec)
+{
+  // +1, damit 0 frei bleibt
+  return ((uint64_t) sec->table_id << 56 | (uint64_t) sec->service_id << 40
+          | (uint64_t) sec->transport_stream_id << 24 | (uint64_t) sec->original_network_id << 8
+          | sec->section_number) + 1;
+}
+
+static struct s_seen_section *find_seen (struct s_seen_section *t, size_t size, uint64_t key)
+{
+  size_t mask = size - 1;
+  for (size_t k = (key * 0x9E3779B97F4A7C15ULL) >> 32 & mask;; k = (k + 1) & mask)
+    if (! t[k].key || t[k].key == key)
+      return &t[k];
+}
+
+int eit_stream_seen (struct eit_stream *s, const struct eit_section *sec)
+{
+  if (2 * (s->seen_num + 1) > s->seen_size)
+    {
+      size_t size = s->seen_size ? 2 * s->seen_size : 1024;
+      struct s_seen_section *t = calloc (size, sizeof (struct s_seen_section));
+      if (! t)
+        return 0;   // dann eben doppelt
+      for (size_t k = 0; k < s->seen_size; ++k)
+        if (s->seen[k].key)
+          *find_seen (t, size, s->seen[k].key) = s->seen[k];
+      free (s->seen);
+      s->seen = t;
+      s->seen_size = size;
+    }
+
+  uint64_t key = section_key (sec);
+  struct s_seen_section *e = find_seen (s->seen, s->seen_size, key);
+  if (e->key && e->version_number == sec->version_number)
+    return 1;
+
+  if (! e->key)
+    s->seen_num++;
+  e->key = key;
+  e->version_number = sec->version_number;
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*!
+  \file eit_stream.h
+
+  Lesen von EIT sections aus einer Datei mit aneinandergereihten sections
+  oder aus einem MPEG-2 Transport Stream (PID 0x12), blockweise mit read,
+  sodass auch sehr große Mitschnitte nicht in den Speicher passen müssen.
+*/
+
+#ifndef EIT_STREAM_H
+#define EIT_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parse_eit.h"
+
+enum eit_stream_type
+{
+  EIT_STREAM_SECTIONS,  // table_id, section_length, ..., CRC_32, dazwischen evtl. 0xFF stuffing
+  EIT_STREAM_TS         // 188 Byte Pakete, die sections kommen aus PID 0x12
+};
+
+// ISO/IEC 13818-1 2.4.4.11: section_length ist 12 bit
+#define EIT_STREAM_MAX_SECTION (3 + 4095)
+
+struct s_seen_section;
+
+struct eit_stream
+{
+  int fd;
+  enum eit_stream_type type;
+
+  uint8_t *buf;           // Lesepuffer
+  size_t pos;
+  size_t len;
+  char eof;
+
+  // TS: Zusammensetzen der sections aus den Paketen
+  uint8_t section[EIT_STREAM_MAX_SECTION];
+  size_t section_len;
+  char in_section;        // nach einer Unterbrechung erst ab dem nächsten payload_unit_start
+  char section_done;      // section wurde zurückgegeben, beim nächsten Aufruf neu beginnen
+  int cc;                 // letzter continuity_counter, -1 = noch keiner
+  const uint8_t *payload; // noch nicht verarbeiteter Teil des aktuellen Pakets
+  const uint8_t *payload_end;
+  const uint8_t *new_section;   // hier beginnt im aktuellen Paket eine neue section
+
+  // bereits gesehene sections, siehe eit_stream_seen
+  struct s_seen_section *seen;
+  size_t seen_size;
+  size_t seen_num;
+
+  // Zähler
+  size_t num_packets;
+  size_t num_sync_errors;
+  size_t num_discontinuities;
+  size_t num_dropped;         // unvollständige sections
+};
+
+// Rückgabe -1 und errno bei Fehler
+int eit_stream_open (struct eit_stream *s, const char *fn, enum eit_stream_type type);
+
+/*
+  Nächste vollständige section, *sec zeigt bis zum nächsten Aufruf in den
+  Puffer des streams. Rückgabe 1, 0 am Ende, -1 und errno bei einem Lesefehler.
+*/
+int eit_stream_next (struct eit_stream *s, const uint8_t **sec, size_t *len);
+
+/*
+  Sections werden zyklisch wiederholt. Rückgabe 1, wenn die section (table_id,
+  service_id, transport_stream_id, original_network_id, section_number) in
+  derselben version_number schon einmal da war.
+*/
+int eit_stream_seen (struct eit_stream *s, const struct eit_section *sec);
+
+void eit_stream_close (struct eit_stream *s);
+
+#endif
@@ -0,0 +1,577 @@
+/*!
+  \file eit_text.c
+
+  Dekodierung der Textfelder nach Annex A (Seite 130) nach UTF-8
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <iconv.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "eit_internal.h"
+
+// gibt die code_table für iconv zurück, aktualisiert p und len
+// Rückgabe (size_t) -1 bei ungültiger Tabellenauswahl
+size_t get_code_table (const uint8_t *p, size_t len, const char **code_table)
+{
+  size_t ret = 0;
+  //fprintf (stderr, "DEBUG crop_code_table: len = '%i'\n", *len);
+
+  // Annex A, Seite 130
+  // A.2 If the first byte of the text field has a value in the range "0x20" to "0xFF"
+  // then this and all subsequent bytes in the text item are coded using
+  // the default character coding table (table 00 - Latin alphabet)
+  *code_table = "ISO-8859-1";
+
+  if (len >= 1)
+    {
+      uint8_t first_byte_value = p[0];
+      //printf ("first_byte_value = 0x%02x\n", first_byte_value);
+      if (first_byte_value < 0x20)
+        {
+          ret++;
+          switch (first_byte_value)
+            {
+            case 0x01:
+              *code_table = "ISO-8859-5";
+              break;
+            case 0x02:
+              *code_table = "ISO-8859-6";
+              break;
+            case 0x03:
+              *code_table = "ISO-8859-7";
+              break;
+            case 0x04:
+              *code_table = "ISO-8859-8";
+              break;
+            case 0x05:
+              *code_table = "ISO-8859-9";
+              break;
+            case 0x06:
+              *code_table = "ISO-8859-10";
+              break;
+            case 0x07:
+              *code_table = "ISO-8859-11";
+              break;
+            case 0x09:
+              *code_table = "ISO-8859-13";
+              break;
+            case 0x0A:
+              *code_table = "ISO-8859-14";
+              break;
+            case 0x0B:
+              *code_table = "ISO-8859-15";
+              break;
+            case 0x11:
+              // Basic Multilingual Plane, zwei Byte je Zeichen, big endian (glibc "ISO-10646" wäre UCS-4)
+              *code_table = "UCS-2BE";
+              break;
+            case 0x13:
+              *code_table = "GB2312";
+              break;
+            case 0x15:
+              *code_table = "ISO-10646/UTF8";
+              break;
+            default:
+              break;
+            }
+
+          if (first_byte_value == 0x10) // dynamically selected part of ISO/IEC 8859
+            {
+              // Table A.4: zweites Byte ist immer 0x00
+              if (len >= 3 && p[1] == 0x00)
+                {
+                  uint8_t third_byte_value = p[2];
+                  ret += 2;
+
+                  switch (third_byte_value)
+                    {
+                    case 0x01:
+                      *code_table = "ISO-8859-1";
+                      break;
+                    case 0x02:
+                      *code_table = "ISO-8859-2";
+                      break;
+                    case 0x03:
+                      *code_table = "ISO-8859-3";
+                      break;
+                    case 0x04:
+                      *code_table = "ISO-8859-4";
+                      break;
+                    case 0x05:
+                      *code_table = "ISO-8859-5";
+                      break;
+                    case 0x06:
+                      *code_table = "ISO-8859-6";
+                      break;
+                    case 0x07:
+                      *code_table = "ISO-8859-7";
+                      break;
+                    case 0x08:
+                      *code_table = "ISO-8859-8";
+                      break;
+                    case 0x09:
+                      *code_table = "ISO-8859-9";
+                      break;
+                    case 0x0A:
+                      *code_table = "ISO-8859-10";
+                      break;
+                    case 0x0B:
+                      *code_table = "ISO-8859-11";
+                      break;
+                    case 0x0D:
+                      *code_table = "ISO-8859-13";
+                      break;
+                    case 0x0E:
+                      *code_table = "ISO-8859-14";
+                      break;
+                    case 0x0F:
+                      *code_table = "ISO-8859-15";
+                      break;
+                    default:
+                      break;
+                    }
+                }
+              else
+                return (size_t) -1;
+            }
+        }
+    }
+  //fprintf (stderr, "DEBUG code_table = '%s'\n", *code_table);
+
+  return ret;
+}
+
+/*
+  iconv Conversion Descriptors werden pro code_table nur einmal geöffnet und
+  danach wiederverwendet, iconv_open/iconv_close pro Textfeld ist teuer.
+  Der Cache gehört zum eit_ctx, ein iconv_t darf nicht von mehreren Threads
+  gleichzeitig benutzt werden.
+*/
+
+// gibt einen (zurückgesetzten) conversion descriptor für code_table zurück
+static iconv_t get_iconv_cd (struct eit_ctx *ctx, const char *code_table)
+{
+  for (int k = 0; k < ctx->iconv_cache_used; ++k)
+    if (! strcmp (ctx->iconv_cache[k].code_table, code_table))
+      {
+        iconv_t cd = ctx->iconv_cache[k].cd;
+        iconv (cd, NULL, NULL, NULL, NULL);
+        return cd;
+      }
+
+  iconv_t cd = iconv_open ("UTF−8", code_table);
+  if (cd == (iconv_t) -1)
+    return cd;
+
+  // get_code_table liefert deutlich weniger als EIT_ICONV_CACHE_SIZE verschiedene Tabellen
+  assert (ctx->iconv_cache_used < EIT_ICONV_CACHE_SIZE);
+  ctx->iconv_cache[ctx->iconv_cache_used].code_table = code_table;
+  ctx->iconv_cache[ctx->iconv_cache_used].cd = cd;
+  ctx->iconv_cache_used++;
+
+  return cd;
+}
+
+void eit_close_iconv_cache (struct eit_ctx *ctx)
+{
+  for (int k = 0; k < ctx->iconv_cache_used; ++k)
+    iconv_close (ctx->iconv_cache[k].cd);
+  ctx->iconv_cache_used = 0;
+}
+
+/*
+  Eingebaute Decoder für die gängigen Tabellen (Latin-1 Default, 8859-9, 8859-15 und UTF-8),
+  damit nicht für jedes Textfeld gconv bemüht werden muss und parse_eit auch auf
+  Receiver-Images ohne gconv Module läuft. Alle anderen Tabellen gehen weiter über iconv.
+*/
+struct s_cp_override
+{
+  uint8_t byte;
+  uint16_t cp;
+};
+
+static const struct s_cp_override iso_8859_1_overrides[] =
+{
+  {0, 0}
+};
+
+static const struct s_cp_override iso_8859_9_overrides[] =
+{
+  {0xD0, 0x011E}, {0xDD, 0x0130}, {0xDE, 0x015E},
+  {0xF0, 0x011F}, {0xFD, 0x0131}, {0xFE, 0x015F},
+  {0, 0}
+};
+
+static const struct s_cp_override iso_8859_15_overrides[] =
+{
+  {0xA4, 0x20AC}, {0xA6, 0x0160}, {0xA8, 0x0161}, {0xB4, 0x017D},
+  {0xB8, 0x017E}, {0xBC, 0x0152}, {0xBD, 0x0153}, {0xBE, 0x0178},
+  {0, 0}
+};
+
+// UTF-8 Kodierung eines Bytes der jeweiligen Tabelle
+struct s_utf8_seq
+{
+  uint8_t len;
+  char c[3];
+};
+
+struct s_fast_table
+{
+  const char *code_table;
+  const struct s_cp_override *overrides;  // Abweichungen von Latin-1, NULL = UTF-8 pass-through
+  struct s_utf8_seq lut[256];
+};
+
+static struct s_fast_table fast_tables[] =
+{
+  {"ISO-8859-1", iso_8859_1_overrides, {{0, {0}}}},
+  {"ISO-8859-9", iso_8859_9_overrides, {{0, {0}}}},
+  {"ISO-8859-15", iso_8859_15_overrides, {{0, {0}}}},
+  {"ISO-10646/UTF8", NULL, {{0, {0}}}}
+};
+
+#define NUM_FAST_TABLES (sizeof (fast_tables) / sizeof (fast_tables[0]))
+
+static pthread_once_t fast_tables_once = PTHREAD_ONCE_INIT;
+
+static void init_fast_table (struct s_fast_table *t)
+{
+  if (! t->overrides)
+    return;
+
+  for (int b = 0; b < 256; ++b)
+    {
+      uint16_t cp = b;
+      for (const struct s_cp_override *o = t->overrides; o->byte; ++o)
+        if (o->byte == b)
+          cp = o->cp;
+
+      struct s_utf8_seq *s = &t->lut[b];
+      if (cp < 0x80)
+        {
+          s->len = 1;
+          s->c[0] = cp;
+        }
+      else if (cp < 0x800)
+        {
+          s->len = 2;
+          s->c[0] = 0xC0 | (cp >> 6);
+          s->c[1] = 0x80 | (cp & 0x3F);
+        }
+      else
+        {
+          s->len = 3;
+          s->c[0] = 0xE0 | (cp >> 12);
+          s->c[1] = 0x80 | ((cp >> 6) & 0x3F);
+          s->c[2] = 0x80 | (cp & 0x3F);
+        }
+    }
+}
+
+static void init_fast_tables (void)
+{
+  for (size_t k = 0; k < NUM_FAST_TABLES; ++k)
+    init_fast_table (&fast_tables[k]);
+}
+
+// gibt den eingebauten Decoder für code_table zurück oder NULL, wenn iconv benötigt wird
+static struct s_fast_table *get_fast_table (const char *code_table)
+{
+  pthread_once (&fast_tables_once, init_fast_tables);
+
+  for (size_t k = 0; k < NUM_FAST_TABLES; ++k)
+    if (! strcmp (fast_tables[k].code_table, code_table))
+      return &fast_tables[k];
+  return NULL;
+}
+
+/*
+  Länge der gültigen UTF-8 Sequenz am Anfang von p (1..4), 0 wenn ungültig
+  (overlong, Surrogate, > U+10FFFF) und -1 wenn sie durch das Ende abgeschnitten ist.
+*/
+static int utf8_seq_len (const uint8_t *p, size_t len)
+{
+  uint8_t c = p[0];
+  int n;
+  uint8_t lo = 0x80, hi = 0xBF;  // erlaubter Bereich für das zweite Byte
+
+  if (c < 0x80)
+    return 1;
+  else if (c >= 0xC2 && c <= 0xDF)
+    n = 2;
+  else if (c >= 0xE0 && c <= 0xEF)
+    {
+      n = 3;
+      if (c == 0xE0)
+        lo = 0xA0;
+      else if (c == 0xED)
+        hi = 0x9F;
+    }
+  else if (c >= 0xF0 && c <= 0xF4)
+    {
+      n = 4;
+      if (c == 0xF0)
+        lo = 0x90;
+      else if (c == 0xF4)
+        hi = 0x8F;
+    }
+  else
+    return 0;
+
+  for (int k = 1; k < n; ++k)
+    {
+      if ((size_t) k >= len)
+        return -1;
+      if (p[k] < lo || p[k] > hi)
+        return 0;
+      lo = 0x80;
+      hi = 0xBF;
+    }
+  return n;
+}
+
+// Semantik wie iconv (3): Rückgabe (size_t) -1 und errno EILSEQ, EINVAL oder E2BIG im Fehlerfall
+static size_t fast_convert (const struct s_fast_table *t, char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft)
+{
+  const uint8_t *in = (const uint8_t *) *inbuf;
+  size_t inleft = *inbytesleft;
+  char *out = *outbuf;
+  size_t outleft = *outbytesleft;
+  int err = 0;
+
+  if (t->overrides)
+    {
+      while (inleft)
+        {
+          const struct s_utf8_seq *s = &t->lut[*in];
+          if (outleft < s->len)
+            {
+              err = E2BIG;
+              break;
+            }
+          memcpy (out, s->c, s->len);
+          out += s->len;
+          outleft -= s->len;
+          in++;
+          inleft--;
+        }
+    }
+  else
+    {
+      while (inleft)
+        {
+          int n = utf8_seq_len (in, inleft);
+          if (n <= 0)
+            {
+              err = (n < 0)? EINVAL : EILSEQ;
+              break;
+            }
+          if (outleft < (size_t) n)
+            {
+              err = E2BIG;
+              break;
+            }
+          memcpy (out, in, n);
+          out += n;
+          outleft -= n;
+          in += n;
+          inleft -= n;
+        }
+    }
+
+  *inbuf = (char *) in;
+  *inbytesleft = inleft;
+  *outbuf = out;
+  *outbytesleft = outleft;
+
+  if (err)
+    {
+      errno = err;
+      return (size_t) -1;
+    }
+  return 0;
+}
+
+/*
+  Annex A.1, Tabelle A.1: 0x86/0x87 schalten die Hervorhebung ein/aus, 0x8A ist CR/LF.
+  Nach der Konvertierung stehen sie als U+0086, U+0087, U+008A (C2 86 usw., aus den
+  Ein-Byte-Tabellen und UTF-8) bzw. U+E086.. (EE 82 86 usw., Zwei-Byte-Tabellen) im Text.
+  Die Hervorhebungen fallen weg, CR/LF wird zu '\n'. Fast alle Texte enthalten weder
+  0xC2 noch 0xEE, daher werden je 16 Byte auf einmal nach diesen Anfangsbytes durchsucht.
+*/
+
+// Index des ersten 0xC2 oder 0xEE in p, len wenn keins vorkommt
+static size_t find_control_lead (const uint8_t *p, size_t len)
+{
+  size_t k = 0;
+#if defined (__SSE2__)
+  const __m128i c2 = _mm_set1_epi8 ((char) 0xC2);
+  const __m128i ee = _mm_set1_epi8 ((char) 0xEE);
+  for (; k + 16 <= len; k += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (p + k));
+      int mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpeq_epi8 (v, c2), _mm_cmpeq_epi8 (v, ee)));
+      if (mask)
+        return k + __builtin_ctz (mask);
+    }
+#elif defined (__ARM_NEON)
+  const uint8x16_t c2 = vdupq_n_u8 (0xC2);
+  const uint8x16_t ee = vdupq_n_u8 (0xEE);
+  for (; k + 16 <= len; k += 16)
+    {
+      uint8x16_t v = vld1q_u8 (p + k);
+      uint8x16_t m = vorrq_u8 (vceqq_u8 (v, c2), vceqq_u8 (v, ee));
+      // NEON hat kein movemask: je 4 bit pro Byte in ein 64 bit Wort schieben
+      uint64_t bits = vget_lane_u64 (vreinterpret_u64_u8 (vshrn_n_u16 (vreinterpretq_u16_u8 (m), 4)), 0);
+      if (bits)
+        return k + (__builtin_ctzll (bits) >> 2);
+    }
+#endif
+  while (k < len && p[k] != 0xC2 && p[k] != 0xEE)
+    k++;
+  return k;
+}
+
+// Länge der Steuerzeichen-Sequenz ab p[0] und deren Code (0x86, 0x87, 0x8A), 0 wenn keine
+static size_t control_code (const uint8_t *p, size_t len, uint8_t *code)
+{
+  size_t n;
+  if (p[0] == 0xC2 && len >= 2)
+    n = 2;
+  else if (p[0] == 0xEE && len >= 3 && p[1] == 0x82)
+    n = 3;
+  else
+    return 0;
+
+  *code = p[n - 1];
+  return (*code == 0x86 || *code == 0x87 || *code == 0x8A) ? n : 0;
+}
+
+// entfernt bzw. ersetzt die Steuerzeichen im UTF-8 Text s, Rückgabe die neue Länge
+static size_t strip_control_codes (char *s, size_t len)
+{
+  uint8_t *p = (uint8_t *) s;
+  size_t k = find_control_lead (p, len);
+  size_t n = k;   // bis hier ist der Text fertig
+
+  while (k < len)
+    {
+      uint8_t code;
+      size_t seq = control_code (p + k, len - k, &code);
+      if (seq)
+        {
+          if (code == 0x8A)
+            p[n++] = '\n';
+          k += seq;
+        }
+      else
+        p[n++] = p[k++];
+
+      size_t next = k + find_control_lead (p + k, len - k);
+      memmove (p + n, p + k, next - k);
+      n += next - k;
+      k = next;
+    }
+  return n;
+}
+
+static void count_code_table (struct eit_stats *stats, const char *code_table, char iconv)
+{
+  int k = 0;
+  while (k < stats->num_code_tables && strcmp (stats->code_tables[k].code_table, code_table))
+    k++;
+  if (k == stats->num_code_tables)
+    {
+      // get_code_table liefert weniger als EIT_ICONV_CACHE_SIZE verschiedene Tabellen
+      assert (k < EIT_ICONV_CACHE_SIZE);
+      stats->code_tables[k].code_table = code_table;
+      stats->num_code_tables++;
+    }
+  stats->code_tables[k].texts++;
+  stats->code_tables[k].iconv += iconv;
+}
+
+static int decode_text (struct eit_ctx *ctx, const uint8_t *p, size_t len, char **out)
+{
+  const char *code_table;
+  size_t inc = get_code_table (p, len, &code_table);
+  if (inc == (size_t) -1)
+    return eit_set_error (ctx, EIT_ERR_CODE_TABLE, "invalid dynamically selected part of ISO/IEC 8859 (len = %zu)", len);
+
+  // get_code_table gibt die Anzahl Zeichen zurück, die für die code Tabelle verwendet wurden (zwischen 0 und 3 Byte)
+  p += inc;
+  len -= inc;
+
+  struct s_fast_table *ft = get_fast_table (code_table);
+  iconv_t cd = (iconv_t) -1;
+  if (! ft)
+    {
+      cd = get_iconv_cd (ctx, code_table);
+      if (cd == (iconv_t) -1)
+        return eit_set_error (ctx, EIT_ERR_ICONV, "iconv_open failed: %i = '%s'", errno, strerror (errno));
+    }
+  if (ctx->stats)
+    count_code_table (ctx->stats, code_table, ! ft);
+
+  // UTF-8 braucht höchstens 3 Byte je Eingabebyte, der Rest wird danach zurückgegeben
+  size_t outbuf_size = 3 * len + 1;
+  size_t outbytesleft = outbuf_size;
+  char *outbuf = eit_alloc (ctx, outbuf_size);
+  if (! outbuf)
+    return eit_set_error (ctx, EIT_ERR_NOMEM, "out of memory");
+
+  char *pout = outbuf;
+  char *pin = (char *) p;
+  // für das nullbyte
+  outbytesleft--;
+
+  size_t nconv;
+  if (ft)
+    nconv = fast_convert (ft, &pin, &len, &pout, &outbytesleft);
+  else
+    nconv = iconv (cd, &pin, &len, &pout, &outbytesleft);
+
+  int ret = EIT_OK;
+  if (nconv == (size_t) -1)
+    {
+      // EINVAL: unvollständiges Zeichen ganz am Ende, das wird ignoriert
+      if (errno == EILSEQ)
+        ret = eit_set_error (ctx, EIT_ERR_CHARSET, "iconv failed: invalid multibyte sequence at index %td", (uint8_t *) pin - p);
+      else if (errno == E2BIG)
+        ret = eit_set_error (ctx, EIT_ERR_TOO_BIG, "iconv failed: output buffer too small");
+    }
+
+  pout = outbuf + strip_control_codes (outbuf, pout - outbuf);
+  *pout = 0;
+  *out = outbuf;
+  eit_arena_shrink (ctx, outbuf, outbuf_size, pout - outbuf + 1);
+
+  return ret;
+}
+
+int eit_decode_text (struct eit_ctx *ctx, const uint8_t *p, size_t len, char **out)
+{
+  if (! ctx->stats)
+    return decode_text (ctx, p, len, out);
+
+  struct timespec t0, t1;
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  int ret = decode_text (ctx, p, len, out);
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  ctx->stats->decode_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+  return ret;
+}
@@ -0,0 +1,84 @@
+/*!
+  \file eit_token.c
+
+  Wörter eines Textes, siehe eit_token.h
+*/
+
+#include "eit_token.h"
+
+static int is_space (unsigned char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+void eit_token_init (struct eit_token *t, const char *s)
+{
+  t->p = s ? s : "";
+  t->word[0] = 0;
+  t->len = 0;
+}
+
+int eit_token_next (struct eit_token *t)
+{
+  for (;;)
+    {
+      const unsigned char *p = (const unsigned char *) t->p;
+      while (*p && is_space (*p))
+        p++;
+      if (! *p)
+        {
+          t->p = (const char *) p;
+          return 0;
+        }
+
+      size_t len = 0;
+      size_t chars = 0;
+      size_t start = 0;     // Anfang des letzten Zeichens in t->word
+      char full = 0;
+      for (; *p && ! is_space (*p); ++p)
+        {
+          unsigned char c = *p;
+          if (c == ',' || c == '.')
+            continue;
+          if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+          // Folgebytes einer UTF-8 Sequenz zählen nicht als eigenes Zeichen
+          char cont = (c & 0xC0) == 0x80;
+          if (! cont)
+            {
+              chars++;
+              start = len;
+            }
+          if (full)
+            continue;
+          if (len < EIT_TOKEN_MAX_LEN)
+            t->word[len++] = c;
+          else
+            {
+              // beim Abschneiden keine halbe UTF-8 Sequenz stehen lassen
+              if (cont)
+                len = start;
+              full = 1;
+            }
+        }
+
+      t->p = (const char *) p;
+      if (chars >= EIT_TOKEN_MIN_CHARS)
+        {
+          t->word[len] = 0;
+          t->len = len;
+          return 1;
+        }
+    }
+}
+
+uint64_t eit_token_hash (const char *s, size_t len)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t k = 0; k < len; ++k)
+    {
+      h ^= (unsigned char) s[k];
+      h *= 0x100000001b3ULL;
+    }
+  return h;
+}
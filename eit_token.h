@@ -0,0 +1,37 @@
+/*!
+  \file eit_token.h
+
+  Zerlegt dekodierte EIT Texte in Wörter für --dedup und --index, wie in
+  find_dup/eq_eit_detect.m: getrennt an Leerzeichen, ',' und '.' entfernt,
+  Wörter mit weniger als EIT_TOKEN_MIN_CHARS Zeichen fallen weg. ASCII
+  Buchstaben werden klein geschrieben.
+*/
+
+#ifndef EIT_TOKEN_H
+#define EIT_TOKEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// UTF-8 Zeichen, nicht Byte
+#define EIT_TOKEN_MIN_CHARS 4
+
+// längere Wörter werden abgeschnitten
+#define EIT_TOKEN_MAX_LEN 64
+
+struct eit_token
+{
+  const char *p;                        // Rest des Textes
+  char word[EIT_TOKEN_MAX_LEN + 1];     // aktuelles Wort, null-terminiert
+  size_t len;
+};
+
+void eit_token_init (struct eit_token *t, const char *s);
+
+// nächstes Wort nach t->word, Rückgabe 0 am Ende des Textes
+int eit_token_next (struct eit_token *t);
+
+// FNV-1a, 64 bit
+uint64_t eit_token_hash (const char *s, size_t len);
+
+#endif
@@ -0,0 +1,210 @@
+/*!
+  \file eit_watch.c
+
+  inotify Überwachung für --watch, siehe eit_watch.h
+
+  inotify überwacht nur einzelne Verzeichnisse, deshalb bekommt jedes
+  Verzeichnis des Baums einen eigenen watch descriptor. paths[wd] ist der
+  Pfad dazu, daraus und dem Namen im Event entsteht der Pfad der Datei.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/inotify.h>
+
+#include "eit_watch.h"
+
+#define WATCH_DIR_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)
+
+struct s_watch
+{
+  int fd;
+  char **paths;       // Index ist der watch descriptor
+  size_t max_paths;
+  const char *suffix;
+  eit_watch_fn fn;
+  void *arg;
+  char report;        // beim Durchsuchen gefundene Dateien melden
+  int fn_ret;         // Rückgabe von fn, wenn != 0
+};
+
+static volatile sig_atomic_t s_stop = 0;
+
+// nftw hat kein Argument für den Aufrufer
+static struct s_watch *s_nftw_watch = NULL;
+
+static void on_signal (int sig)
+{
+  (void) sig;
+  s_stop = 1;
+}
+
+static int has_suffix (const char *fn, const char *suffix)
+{
+  size_t len = strlen (fn);
+  size_t suffix_len = strlen (suffix);
+  return len > suffix_len && ! strcasecmp (fn + len - suffix_len, suffix);
+}
+
+static int add_watch (struct s_watch *w, const char *path)
+{
+  int wd = inotify_add_watch (w->fd, path, WATCH_DIR_MASK);
+  if (wd < 0)
+    return -1;
+
+  if ((size_t) wd >= w->max_paths)
+    {
+      size_t max = w->max_paths ? 2 * w->max_paths : 64;
+      while (max <= (size_t) wd)
+        max *= 2;
+      char **tmp = realloc (w->paths, max * sizeof (char *));
+      if (! tmp)
+        return -1;
+      memset (tmp + w->max_paths, 0, (max - w->max_paths) * sizeof (char *));
+      w->paths = tmp;
+      w->max_paths = max;
+    }
+
+  // dasselbe Verzeichnis (z.B. nach einem rename) behält seinen wd
+  char *p = strdup (path);
+  if (! p)
+    return -1;
+  free (w->paths[wd]);
+  w->paths[wd] = p;
+  return 0;
+}
+
+static int add_tree_entry (const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) ftwbuf;
+  struct s_watch *w = s_nftw_watch;
+
+  if (typeflag == FTW_D && add_watch (w, fpath))
+    fprintf (stderr, "WARNING: cannot watch %s: %s\n", fpath, strerror (errno));
+  else if (typeflag == FTW_F && w->report && has_suffix (fpath, w->suffix))
+    {
+      w->fn_ret = w->fn (w->arg, fpath);
+      return w->fn_ret != 0;
+    }
+  else if (typeflag == FTW_DNR)
+    fprintf (stderr, "WARNING: cannot read directory %s\n", fpath);
+  return 0;
+}
+
+// überwacht path und alle Verzeichnisse darunter, Rückgabe != 0 bei Fehler oder Abbruch durch fn (w->fn_ret)
+static int add_tree (struct s_watch *w, const char *path, char report)
+{
+  s_nftw_watch = w;
+  w->report = report;
+  return nftw (path, add_tree_entry, 32, FTW_PHYS);
+}
+
+static int handle_event (struct s_watch *w, const struct inotify_event *ev)
+{
+  if (ev->mask & IN_Q_OVERFLOW)
+    {
+      fprintf (stderr, "WARNING: inotify queue overflow, events were lost\n");
+      return 0;
+    }
+
+  if (ev->wd < 0 || (size_t) ev->wd >= w->max_paths || ! w->paths[ev->wd])
+    return 0;
+
+  // Verzeichnis gelöscht oder nicht mehr erreichbar
+  if (ev->mask & IN_IGNORED)
+    {
+      free (w->paths[ev->wd]);
+      w->paths[ev->wd] = NULL;
+      return 0;
+    }
+
+  if (! ev->len)
+    return 0;
+
+  char fn[PATH_MAX];
+  if (snprintf (fn, sizeof (fn), "%s/%s", w->paths[ev->wd], ev->name) >= (int) sizeof (fn))
+    {
+      fprintf (stderr, "WARNING: path too long: %s/%s\n", w->paths[ev->wd], ev->name);
+      return 0;
+    }
+
+  if (ev->mask & IN_ISDIR)
+    {
+      // in hineinverschobenen Verzeichnissen sind die Dateien fertig und werden gemeldet, in neu angelegten
+      // werden sie vielleicht noch geschrieben und kommen danach mit IN_CLOSE_WRITE
+      // ist es schon wieder weg, fehlt nur dessen Überwachung
+      if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+        add_tree (w, fn, (ev->mask & IN_MOVED_TO) != 0);
+      return w->fn_ret;
+    }
+
+  if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && has_suffix (fn, w->suffix))
+    return w->fn (w->arg, fn);
+  return 0;
+}
+
+int eit_watch (const char **dirs, int num_dirs, const char *suffix, eit_watch_fn fn, void *arg)
+{
+  struct s_watch w;
+  memset (&w, 0, sizeof (w));
+  w.suffix = suffix;
+  w.fn = fn;
+  w.arg = arg;
+
+  w.fd = inotify_init1 (IN_CLOEXEC);
+  if (w.fd < 0)
+    return -1;
+
+  int ret = 0;
+  // für Unterverzeichnisse gibt es nur eine Warnung, DIR selbst muss überwacht werden können
+  for (int k = 0; k < num_dirs && ! ret; ++k)
+    if (add_watch (&w, dirs[k]) || add_tree (&w, dirs[k], 0))
+      ret = -1;
+
+  // ohne SA_RESTART, damit read mit EINTR zurückkommt
+  struct sigaction sa;
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = on_signal;
+  sigemptyset (&sa.sa_mask);
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+
+  // ausgerichtet für struct inotify_event
+  char buf[65536] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  while (! ret && ! s_stop)
+    {
+      ssize_t n = read (w.fd, buf, sizeof (buf));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        {
+          perror ("inotify read");
+          ret = -1;
+          break;
+        }
+
+      const struct inotify_event *ev;
+      for (char *p = buf; p < buf + n && ! ret; p += sizeof (struct inotify_event) + ev->len)
+        {
+          ev = (const struct inotify_event *) p;
+          ret = handle_event (&w, ev);
+        }
+    }
+
+  int e = errno;
+  for (size_t k = 0; k < w.max_paths; ++k)
+    free (w.paths[k]);
+  free (w.paths);
+  close (w.fd);
+  errno = e;
+  return ret;
+}
@@ -0,0 +1,25 @@
+/*!
+  \file eit_watch.h
+
+  --watch DIR: überwacht DIR und alle Unterverzeichnisse mit inotify und
+  meldet jede Datei mit passender Endung, sobald sie fertig geschrieben
+  (IN_CLOSE_WRITE) oder hineinverschoben (IN_MOVED_TO) wurde. Neue
+  Unterverzeichnisse werden mit überwacht, die Dateien hineinverschobener
+  Verzeichnisse dabei gemeldet.
+*/
+
+#ifndef EIT_WATCH_H
+#define EIT_WATCH_H
+
+// Rückgabe != 0 beendet eit_watch mit diesem Wert
+typedef int (*eit_watch_fn) (void *arg, const char *path);
+
+/*
+  Überwacht die num_dirs Verzeichnisse dirs bis SIGINT oder SIGTERM und ruft
+  fn für jede neue Datei, deren Name auf suffix endet ("" = alle). Beim Start
+  schon vorhandene Dateien werden nicht gemeldet. Rückgabe 0, -1 und errno
+  wenn die Überwachung nicht eingerichtet werden konnte, oder der Wert von fn.
+*/
+int eit_watch (const char **dirs, int num_dirs, const char *suffix, eit_watch_fn fn, void *arg);
+
+#endif
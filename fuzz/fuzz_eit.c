@@ -0,0 +1,151 @@
+/*!
+  \file fuzz_eit.c
+
+  Fuzz-Ziel für libFuzzer (make fuzz, braucht clang): jede Eingabe geht
+  als .eit Datei durch eit_parse, als section durch eit_parse_section und
+  als Event-Schleife durch eit_parse_event, mit ASan und UBSan.
+
+  Ohne clang übersetzt make fuzz-gcc dasselbe Ziel mit FUZZ_STANDALONE und
+  eigenem main: jede Datei auf der Kommandozeile wird mit allen Längen von
+  0 bis zur vollen Größe geparst (abgeschnittene Dateien) und danach
+  ROUNDS mal mit ein paar zufällig geänderten Bytes.
+
+    fuzz_eit_gcc [-r ROUNDS] FILE...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parse_eit.h"
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+  // über alle Eingaben derselbe Kontext, so werden auch Arena und iconv Cache wiederverwendet
+  static struct eit_ctx ctx;
+  static char initialized = 0;
+  if (! initialized)
+    {
+      eit_ctx_init (&ctx);
+      initialized = 1;
+    }
+
+  // eine Kopie genau der Länge size, damit ASan jeden Zugriff dahinter meldet
+  uint8_t *buf = malloc (size ? size : 1);
+  if (! buf)
+    return 0;
+  memcpy (buf, data, size);
+
+  struct eit_event ev;
+  eit_parse (buf, size, &ev, &ctx);
+
+  // als section nur mit passender CRC_32, die Event-Schleife daher immer auch direkt über die Eingabe
+  struct eit_section sec;
+  const uint8_t *p = buf;
+  size_t left = size;
+  if (eit_parse_section (buf, size, &sec, &ctx) == EIT_OK)
+    {
+      p = sec.events;
+      left = sec.events_len;
+    }
+  while (left)
+    {
+      // consumed ist mindestens 12, bei Fehlern im Kopf der Rest
+      size_t consumed;
+      eit_parse_event (p, left, &consumed, &ev, &ctx);
+      p += consumed;
+      left -= consumed;
+    }
+
+  free (buf);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+
+// xorshift64*
+static uint64_t rng (void)
+{
+  s_rng ^= s_rng >> 12;
+  s_rng ^= s_rng << 25;
+  s_rng ^= s_rng >> 27;
+  return s_rng * 0x2545F4914F6CDD1Dull;
+}
+
+static uint8_t *read_file (const char *fn, size_t *len)
+{
+  FILE *f = fopen (fn, "rb");
+  if (! f)
+    return NULL;
+  size_t size = 4096;
+  uint8_t *data = malloc (size);
+  *len = 0;
+  size_t n;
+  while (data && (n = fread (data + *len, 1, size - *len, f)) > 0)
+    {
+      *len += n;
+      if (*len == size)
+        {
+          uint8_t *tmp = realloc (data, 2 * size);
+          if (! tmp)
+            free (data);
+          data = tmp;
+          size *= 2;
+        }
+    }
+  fclose (f);
+  return data;
+}
+
+int main (int argc, char *argv[])
+{
+  int rounds = 1000;
+  int opt;
+  while ((opt = getopt (argc, argv, "r:")) != -1)
+    if (opt == 'r')
+      rounds = atoi (optarg);
+    else
+      {
+        fprintf (stderr, "usage: %s [-r ROUNDS] FILE...\n", argv[0]);
+        return 1;
+      }
+
+  for (int k = optind; k < argc; ++k)
+    {
+      size_t len;
+      uint8_t *data = read_file (argv[k], &len);
+      if (! data)
+        {
+          perror (argv[k]);
+          return 1;
+        }
+
+      for (size_t n = 0; n <= len; ++n)
+        LLVMFuzzerTestOneInput (data, n);
+
+      // 1..8 Bytes ändern, vor allem Längenfelder zu groß oder zu klein
+      uint8_t *mut = malloc (len ? len : 1);
+      for (int r = 0; mut && len && r < rounds; ++r)
+        {
+          memcpy (mut, data, len);
+          int num = 1 + rng () % 8;
+          for (int i = 0; i < num; ++i)
+            {
+              uint64_t v = rng ();
+              mut[(v >> 8) % len] = (v & 1) ? (uint8_t) (v >> 1) : mut[(v >> 8) % len] ^ (1 << ((v >> 1) & 7));
+            }
+          LLVMFuzzerTestOneInput (mut, (rng () & 3) ? len : rng () % (len + 1));
+        }
+      free (mut);
+      free (data);
+      printf ("%s: %zu bytes, %zu truncations, %i mutations\n", argv[k], len, len + 1, rounds);
+    }
+  return 0;
+}
+
+#endif
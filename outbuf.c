@@ -0,0 +1,141 @@
+/*!
+  \file outbuf.c
+
+  Wachsender Ausgabepuffer, siehe outbuf.h
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "outbuf.h"
+
+void outbuf_init (struct outbuf *b)
+{
+  b->data = NULL;
+  b->len = 0;
+  b->size = 0;
+  b->failed = 0;
+}
+
+void outbuf_free (struct outbuf *b)
+{
+  free (b->data);
+  outbuf_init (b);
+}
+
+int outbuf_reserve (struct outbuf *b, size_t n)
+{
+  if (b->failed)
+    return 0;
+  if (b->size - b->len >= n)
+    return 1;
+
+  size_t size = b->size ? b->size : 4096;
+  while (size - b->len < n)
+    size *= 2;
+
+  char *tmp = realloc (b->data, size);
+  if (! tmp)
+    {
+      b->failed = 1;
+      return 0;
+    }
+  b->data = tmp;
+  b->size = size;
+  return 1;
+}
+
+void outbuf_put_int (struct outbuf *b, long v)
+{
+  char tmp[24];
+  char *p = tmp + sizeof (tmp);
+  unsigned long u = (v < 0)? -(unsigned long) v : (unsigned long) v;
+
+  do
+    {
+      *--p = '0' + u % 10;
+      u /= 10;
+    }
+  while (u);
+
+  if (v < 0)
+    *--p = '-';
+  outbuf_put (b, p, tmp + sizeof (tmp) - p);
+}
+
+void outbuf_put_int02 (struct outbuf *b, int v)
+{
+  if (v >= 0 && v < 10)
+    outbuf_putc (b, '0');
+  outbuf_put_int (b, v);
+}
+
+/*
+  Dieselbe Bedingung wie früher in print_JSON_escaped:
+  '"', '\' und 0x00..0x1f werden escaped, alles andere (auch UTF-8) bleibt.
+*/
+static inline int needs_escape (uint8_t c)
+{
+  return c == '"' || c == '\\' || c < 0x20;
+}
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+// ist in den 8 Bytes von w mindestens eins, das escaped werden muss?
+static inline int word_needs_escape (uint64_t w)
+{
+  uint64_t quote = w ^ (ONES * '"');
+  uint64_t backslash = w ^ (ONES * '\\');
+
+  uint64_t t = ((quote - ONES) & ~quote)
+               | ((backslash - ONES) & ~backslash)
+               | ((w - ONES * 0x20) & ~w);
+  return (t & HIGHS) != 0;
+}
+
+void outbuf_put_json_escaped (struct outbuf *b, const char *s)
+{
+  static const char hex[] = "0123456789abcdef";
+  size_t len = strlen (s);
+  const uint8_t *p = (const uint8_t *) s;
+  const uint8_t *end = p + len;
+
+  if (! outbuf_reserve (b, len))
+    return;
+
+  while (p < end)
+    {
+      // Lauf unkritischer Bytes suchen, 8 Byte auf einmal
+      const uint8_t *run = p;
+      while (end - p >= 8)
+        {
+          uint64_t w;
+          memcpy (&w, p, 8);
+          if (word_needs_escape (w))
+            break;
+          p += 8;
+        }
+      while (p < end && ! needs_escape (*p))
+        p++;
+
+      outbuf_put (b, (const char *) run, p - run);
+
+      if (p < end)
+        {
+          char esc[6] = {'\\', 'u', '0', '0', hex[*p >> 4], hex[*p & 0x0F]};
+          outbuf_put (b, esc, 6);
+          p++;
+        }
+    }
+}
+
+int outbuf_flush (struct outbuf *b, FILE *f)
+{
+  int ret = (b->failed)? -1 : 0;
+  if (b->len && fwrite (b->data, 1, b->len, f) != b->len)
+    ret = -1;
+  b->len = 0;
+  b->failed = 0;
+  return ret;
+}
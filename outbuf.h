@@ -0,0 +1,60 @@
+/*!
+  \file outbuf.h
+
+  Wachsender Ausgabepuffer für die JSON Ausgabe von parse_eit, eine Datei
+  wird komplett im Puffer erzeugt und dann mit einem fwrite ausgegeben.
+*/
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+struct outbuf
+{
+  char *data;
+  size_t len;
+  size_t size;
+  char failed;    // malloc fehlgeschlagen, weitere Ausgaben werden verworfen
+};
+
+void outbuf_init (struct outbuf *b);
+void outbuf_free (struct outbuf *b);
+
+// malloc fehlgeschlagen -> Rückgabe 0, sonst 1
+int outbuf_reserve (struct outbuf *b, size_t n);
+
+static inline void outbuf_put (struct outbuf *b, const char *s, size_t n)
+{
+  if (b->size - b->len < n && ! outbuf_reserve (b, n))
+    return;
+  memcpy (b->data + b->len, s, n);
+  b->len += n;
+}
+
+static inline void outbuf_puts (struct outbuf *b, const char *s)
+{
+  outbuf_put (b, s, strlen (s));
+}
+
+static inline void outbuf_putc (struct outbuf *b, char c)
+{
+  if (b->len == b->size && ! outbuf_reserve (b, 1))
+    return;
+  b->data[b->len++] = c;
+}
+
+void outbuf_put_int (struct outbuf *b, long v);
+
+// wie printf ("%02i", v)
+void outbuf_put_int02 (struct outbuf *b, int v);
+
+// s als Inhalt eines JSON strings, '"', '\' und Steuerzeichen als \u00xx
+void outbuf_put_json_escaped (struct outbuf *b, const char *s);
+
+// schreibt den Puffer mit einem fwrite nach f und leert ihn, Rückgabe -1 bei Fehler
+int outbuf_flush (struct outbuf *b, FILE *f);
+
+#endif
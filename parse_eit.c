@@ -1,12 +1,13 @@
 /*!
-  \file eit_parse.c
+  \file parse_eit.c
   \author Andreas Weber
 
   tool for parsing EIT (DVB Event Information Table) files
   Copyright (C) 2016..2023 Andreas Weber
 
   Gibt die Informationen ine einer DreamBox 7025+ (vielleicht auch andere)
-  .eit Datei als Text aus.
+  .eit Datei als Text aus. Das Parsen selbst macht libparse_eit (parse_eit.h),
+  hier ist nur noch die JSON Ausgabe.
 
   Probleme:
     - den Text muss man escapen, da auch " darin vorkommt, siehe Schneewelt1.eit
@@ -16,598 +17,1269 @@
 */
 
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <iconv.h>
 #include <inttypes.h>
-#include <assert.h>
-
-//#define DEBUG
-
-struct s_duration
+#include <strings.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "parse_eit.h"
+#include "outbuf.h"
+#include "eit_file.h"
+#include "eit_cache.h"
+#include "eit_output.h"
+#include "eit_stream.h"
+#include "eit_serve.h"
+#include "eit_watch.h"
+#include "eit_dedup.h"
+#include "eit_index.h"
+#include "eit_token.h"
+#include "eit_columns.h"
+#include "eit_run_stats.h"
+#include "eit_reader.h"
+#include "eit_store.h"
+
+// --input
+enum input_type
 {
-  int hour;
-  int minute;
-  int second;
+  INPUT_EIT,        // Enigma2 .eit Datei, ein Event
+  INPUT_SECTIONS,   // aneinandergereihte EIT sections
+  INPUT_TS          // Transport Stream, EIT auf PID 0x12
 };
+static enum input_type input_type = INPUT_EIT;
 
-/*
-  5.2.4 Event Information Table (EIT) : Seite 35
+// --format
+static enum output_format output_format = OUTPUT_JSON;
 
-  duration: A 24-bit field containing the duration of the event in hours, minutes, seconds. format: 6 digits,
-  4-bit BCD = 24 bit.
+// --fields, enum eit_field
+static unsigned output_fields = EIT_FIELD_ALL;
 
-  EXAMPLE 3:
-    01:45:30 is coded as "0x014530".
-*/
+// --cache FILE, NULL wenn nicht angegeben
+static struct eit_cache *cache = NULL;
 
-uint8_t parse_duration (const uint8_t *p, size_t len, struct s_duration *s)
-{
-  if (len < 3)
-    return 0;
-
-  s->hour   = (p[0] >> 4) * 10 + (p[0] & 0x0F);
-  s->minute = (p[1] >> 4) * 10 + (p[1] & 0x0F);
-  s->second = (p[2] >> 4) * 10 + (p[2] & 0x0F);
-  return 3;
-}
+// --export FILE: die Events werden hier gesammelt statt ausgegeben
+static struct eit_columns *columns = NULL;
 
-struct s_start_time
-{
-  int Y;
-  int D;
-  int M;
+// --stats, NULL wenn nicht angegeben
+static struct eit_run_stats *run_stats = NULL;
 
-  struct s_duration t;   // ist eigentlich die Startzeit, hat aber gleiches Format wie duration
-};
+// --prefetch[=N]: so viele Dateien werden im Voraus gelesen, 0 ohne --prefetch
+static unsigned prefetch_depth = 0;
 
 /*
-  5.2.4 Event Information Table (EIT) : Seite 35
-
-  start_time: This 40-bit field contains the start time of the event in Universal Time, Co-ordinated (UTC) and Modified
-    Julian Date (MJD) (see annex C). This field is coded as 16 bits giving the 16 LSBs of MJD followed by 24 bits coded as
-    6 digits in 4-bit Binary Coded Decimal (BCD). If the start time is undefined (e.g. for an event in a NVOD reference
-    service) all bits of the field are set to "1".
-
-  EXAMPLE 1:
-    93/10/13 12:45:00 is coded as "0xC079124500".
+  Zustand einer einzelnen Datei bzw. eines Threads, damit mehrere Dateien gleichzeitig (-j) geparst werden können
 */
+struct s_parse_state
+{
+  struct outbuf *out;
+  struct eit_ctx ctx;
+  struct eit_file in;
+  char can_flush;   // ausgegebene Events dürfen schon während einer Datei geschrieben werden (nicht bei -j)
+  struct eit_run_stats *stats;  // --stats, bei -j eigene Zähler je Thread, sonst NULL
+  struct eit_reader *reader;    // --prefetch, liefert die Dateien in der Reihenfolge von parse_files, sonst NULL
+  struct eit_store *store;      // --serve mit Eingabedateien: alle Events kommen zusätzlich hierhin, sonst NULL
+  const char *store_fn;         // Name der Datei im store (realpath), damit x.eit und /abs/x.eit dieselbe sind
+};
 
-uint8_t parse_start_time (const uint8_t *p, size_t len, struct s_start_time *s)
+// --stats: Anfangszeit für stats_end, ohne --stats 0
+static uint64_t stats_begin (const struct s_parse_state *ps)
 {
-  if (len < 5)
+  return ps->stats ? eit_run_stats_now () : 0;
+}
+
+// addiert die Zeit seit t zu stage, Rückgabe ist der Anfang der nächsten Stufe
+static uint64_t stats_end (const struct s_parse_state *ps, enum eit_stage stage, uint64_t t)
+{
+  if (! ps->stats)
     return 0;
+  uint64_t now = eit_run_stats_now ();
+  ps->stats->ns[stage] += now - t;
+  return now;
+}
 
-  // EXAMPLE 1 from above
-  //p[0] = 0xC0;
-  //p[1] = 0x79;
+// so viel Ausgabe wird bei großen Transport Streams gesammelt, bevor sie geschrieben wird
+#define STREAM_FLUSH_SIZE (1024 * 1024)
 
-  // Seite 145: Annex C
-  int MJD = p[0] << 8 | p[1];
+// json: vor jedem Objekt steht ",\n", beim allerersten Objekt der Ausgabe fällt das weg
+static char s_records_written = 0;
 
-  int Ys = (MJD - 15078.2) / 365.25;
-  int tmp = (Ys * 365.25);
-  int Ms = (MJD - 14956.1 - tmp) / 30.6001;
-  int tmp1 = (Ys * 365.25);
-  int tmp2 = (Ms * 30.6001);
-  s->D = MJD - 14956 - tmp1 - tmp2;
-  int K = (Ms == 14 || Ms == 15)? 1 : 0;
-  s->Y = Ys + K;
-  s->M = Ms - 1 - K * 12;
+// schreibt fertige Datensätze nach stdout, nur aus einem Thread aufrufen
+int flush_output (struct outbuf *b)
+{
+  uint64_t t = run_stats ? eit_run_stats_now () : 0;
+  if (output_format == OUTPUT_JSON && ! s_records_written && b->len >= 2)
+    {
+      memmove (b->data, b->data + 2, b->len - 2);
+      b->len -= 2;
+    }
+  if (b->len)
+    s_records_written = 1;
+  int ret = outbuf_flush (b, stdout);
+  if (run_stats)
+    run_stats->ns[EIT_STAGE_WRITE] += eit_run_stats_now () - t;
+  return ret;
+}
 
-  //printf ("MJD = %i\n");
-  //printf ("Y/M/D = %i/%i/%i\n", s->Y, s->M, s->D);
+static void begin_record (struct outbuf *out)
+{
+  if (output_format == OUTPUT_JSON)
+    outbuf_puts (out, ",\n");
+}
 
-  parse_duration (p + 2, len - 2, &s->t);
-  //printf ("%02i:%02i:%02i\n", s->t.hour, s->t.minute, s->t.second);
+// Fehlermeldung für stderr, bei mehreren übersprungenen Descriptoren mit deren Anzahl
+static void report_error (const char *fn, const char *where, const struct eit_event *ev, const char *errmsg)
+{
+  if (ev && ev->num_errors > 1)
+    fprintf (stderr, "ERROR: %s%s: %s (%u errors)\n", fn, where, errmsg, ev->num_errors);
+  else
+    fprintf (stderr, "ERROR: %s%s: %s\n", fn, where, errmsg);
+}
 
-  return 5;
+// Datensatz nur mit "filename" und "error", z.B. wenn die Datei nicht gelesen werden kann
+static void put_error_record (struct outbuf *out, const char *fn, const char *what)
+{
+  char msg[512];
+  snprintf (msg, sizeof (msg), "%s: %s", what, strerror (errno));
+  fprintf (stderr, "%s %s: %s\n", what, fn, strerror (errno));
+  if (! columns)
+    output_event (out, output_format, output_fields, fn, NULL, NULL, msg);
 }
 
-/*
-void dump (const uint8_t *p, size_t len)
+// gibt ein Event aus bzw. hängt es bei --export an die Spalten an
+static void put_event (struct s_parse_state *ps, const char *fn, const struct eit_section *sec,
+                       const struct eit_event *ev, const char *errmsg)
 {
-  for (unsigned int k = 0; k < len; ++k)
-    printf ("%3u : 0x%02x  %3i '%c'\n", k, p[k], p[k], p[k]);
+  uint64_t t = stats_begin (ps);
+  if (! columns)
+    output_event (ps->out, output_format, output_fields, fn, sec, ev, errmsg);
+  // wie bei malloc Fehlern im Puffer bricht flush_output dann ab
+  else if (eit_columns_add (columns, fn, sec, ev))
+    ps->out->failed = 1;
+  if (ps->store && eit_store_add (ps->store, ps->store_fn ? ps->store_fn : fn, sec, ev))
+    ps->out->failed = 1;
+
+  if (ps->stats)
+    {
+      ps->stats->events++;
+      stats_end (ps, EIT_STAGE_OUTPUT, t);
+    }
 }
+
+/*
+  Rückgabewerte von parse_file und den Funktionen darunter: 0 alles in Ordnung,
+  1 die Datei enthielt Fehler (steht in "error", es geht mit der nächsten weiter),
+  -1 die Ausgabe selbst ist fehlgeschlagen und es wird abgebrochen
 */
 
-// gibt die code_table für iconv zurück, aktualisiert p und len
-size_t get_code_table (char *p, size_t len, char **code_table)
+// alle Events einer section ausgeben
+int parse_section_events (struct s_parse_state *ps, const char *fn, const struct eit_section *sec)
 {
-  size_t ret = 0;
-  //fprintf (stderr, "DEBUG crop_code_table: len = '%i'\n", *len);
-
-  // Annex A, Seite 130
-  // A.2 If the first byte of the text field has a value in the range "0x20" to "0xFF"
-  // then this and all subsequent bytes in the text item are coded using
-  // the default character coding table (table 00 - Latin alphabet)
-  *code_table = "ISO-8859-1";
+  const uint8_t *p = sec->events;
+  size_t left = sec->events_len;
+  int ret = 0;
 
-  if (len >= 1)
+  while (left > 0)
     {
-      uint8_t first_byte_value = p[0];
-      //printf ("first_byte_value = 0x%02x\n", first_byte_value);
-      if (first_byte_value < 0x20)
+      begin_record (ps->out);
+      if (output_format == OUTPUT_JSON)
+        output_json_head (ps->out, fn, sec);
+
+      struct eit_event ev;
+      size_t consumed;
+      uint64_t t = stats_begin (ps);
+      int err = eit_parse_event (p, left, &consumed, &ev, &ps->ctx);
+      stats_end (ps, EIT_STAGE_PARSE, t);
+      const char *errmsg = err ? eit_ctx_errmsg (&ps->ctx) : NULL;
+      put_event (ps, fn, sec, &ev, errmsg);
+
+      if (err)
         {
-          ret++;
-          switch (first_byte_value)
-            {
-            case 0x01:
-              *code_table = "ISO-8859-5";
-              break;
-            case 0x02:
-              *code_table = "ISO-8859-6";
-              break;
-            case 0x03:
-              *code_table = "ISO-8859-7";
-              break;
-            case 0x04:
-              *code_table = "ISO-8859-8";
-              break;
-            case 0x05:
-              *code_table = "ISO-8859-9";
-              break;
-            case 0x06:
-              *code_table = "ISO-8859-10";
-              break;
-            case 0x07:
-              *code_table = "ISO-8859-11";
-              break;
-            case 0x09:
-              *code_table = "ISO-8859-13";
-              break;
-            case 0x0A:
-              *code_table = "ISO-8859-14";
-              break;
-            case 0x0B:
-              *code_table = "ISO-8859-15";
-              break;
-            case 0x11:
-              *code_table = "ISO-10646";
-              break;
-            case 0x13:
-              *code_table = "GB2312";
-              break;
-            case 0x15:
-              *code_table = "ISO-10646/UTF8";
-              break;
-            default:
-              break;
-            }
-
-          if (first_byte_value == 0x10) // dynamically selected part of ISO/IEC 8859
-            {
-              if (len >= 3)
-                {
-                  uint8_t second_byte_value = p[1];
-                  assert (second_byte_value == 0x00);  // Table A.4
-
-                  uint8_t third_byte_value = p[2];
-                  ret += 2;
-
-                  switch (third_byte_value)
-                    {
-                    case 0x01:
-                      *code_table = "ISO-8859-1";
-                      break;
-                    case 0x02:
-                      *code_table = "ISO-8859-2";
-                      break;
-                    case 0x03:
-                      *code_table = "ISO-8859-3";
-                      break;
-                    case 0x04:
-                      *code_table = "ISO-8859-4";
-                      break;
-                    case 0x05:
-                      *code_table = "ISO-8859-5";
-                      break;
-                    case 0x06:
-                      *code_table = "ISO-8859-6";
-                      break;
-                    case 0x07:
-                      *code_table = "ISO-8859-7";
-                      break;
-                    case 0x08:
-                      *code_table = "ISO-8859-8";
-                      break;
-                    case 0x09:
-                      *code_table = "ISO-8859-9";
-                      break;
-                    case 0x0A:
-                      *code_table = "ISO-8859-10";
-                      break;
-                    case 0x0B:
-                      *code_table = "ISO-8859-11";
-                      break;
-                    case 0x0D:
-                      *code_table = "ISO-8859-13";
-                      break;
-                    case 0x0E:
-                      *code_table = "ISO-8859-14";
-                      break;
-                    case 0x0F:
-                      *code_table = "ISO-8859-15";
-                      break;
-                    default:
-                      break;
-                    }
-                }
-              else
-                {
-                  fprintf (stderr, "ERROR: dynamically selected part of ISO/IEC 8859 but len = %zu (<3)\n", len);
-                  exit (-1);
-                }
-            }
+          char where[64];
+          snprintf (where, sizeof (where), ": service_id %i, section_number %i", sec->service_id, sec->section_number);
+          report_error (fn, where, &ev, errmsg);
+          ret = 1;
         }
-    }
-  //fprintf (stderr, "DEBUG code_table = '%s'\n", *code_table);
 
+      // bei einem abgeschnittenen Event ist consumed == left
+      p += consumed;
+      left -= consumed;
+    }
   return ret;
 }
 
-void print_JSON_escaped (const char *p)
+// --input=sections|ts: ein Datensatz pro Event, Wiederholungen einer section werden übersprungen
+int parse_stream (struct s_parse_state *ps, const char *fn)
 {
-  while (*p)
+  struct eit_stream s;
+  if (eit_stream_open (&s, fn, (input_type == INPUT_TS)? EIT_STREAM_TS : EIT_STREAM_SECTIONS))
     {
-      if (*p == '"' || *p == '\\' || ('\x00' <= *p && *p <= '\x1f'))
-        printf ("\\u%04x", (int)*p);
-      else
-        putchar (*p);
-      p++;
+      begin_record (ps->out);
+      if (output_format == OUTPUT_JSON)
+        output_json_head (ps->out, fn, NULL);
+      put_error_record (ps->out, fn, "error opening file");
+      return 1;
+    }
+
+  int ret = 0;
+  int r = 0;
+  size_t num_crc_errors = 0;
+  const uint8_t *p;
+  size_t len;
+  while (ret >= 0)
+    {
+      uint64_t t = stats_begin (ps);
+      r = eit_stream_next (&s, &p, &len);
+      if (r <= 0)
+        break;
+      t = stats_end (ps, EIT_STAGE_READ, t);
+      if (ps->stats)
+        ps->stats->bytes += len;
+
+      struct eit_section sec;
+      int err = eit_parse_section (p, len, &sec, &ps->ctx);
+      stats_end (ps, EIT_STAGE_PARSE, t);
+
+      // andere Tabellen, z.B. stuffing tables auf PID 0x12
+      if (err == EIT_ERR_NOT_EIT)
+        continue;
+      // gestörter Empfang: verwerfen, die Wiederholung der section kommt meist durch
+      if (err == EIT_ERR_CRC)
+        {
+          num_crc_errors++;
+          continue;
+        }
+      if (err)
+        {
+          fprintf (stderr, "WARNING: %s: skipping section: %s\n", fn, eit_ctx_errmsg (&ps->ctx));
+          continue;
+        }
+
+      if (! sec.current_next_indicator || eit_stream_seen (&s, &sec))
+        continue;
+
+      if (parse_section_events (ps, fn, &sec))
+        ret = 1;
+
+      if (ps->can_flush && ps->out->len > STREAM_FLUSH_SIZE && flush_output (ps->out))
+        ret = -1;
+    }
+
+  if (r < 0)
+    {
+      begin_record (ps->out);
+      if (output_format == OUTPUT_JSON)
+        output_json_head (ps->out, fn, NULL);
+      put_error_record (ps->out, fn, "error reading file");
+      if (! ret)
+        ret = 1;
     }
+  if (s.num_dropped || s.num_sync_errors || num_crc_errors)
+    fprintf (stderr, "WARNING: %s: %zu sections with CRC errors, %zu incomplete sections, %zu sync errors, %zu discontinuities\n",
+             fn, num_crc_errors, s.num_dropped, s.num_sync_errors, s.num_discontinuities);
+
+  eit_stream_close (&s);
+  return ret;
 }
 
-void dump_text (uint8_t *p, size_t len, char append)
+// Inhalt von fn, mit --prefetch die nächste Datei des Readers (das ist fn)
+static int load_file (struct s_parse_state *ps, const char *fn, const uint8_t **data, size_t *len)
 {
-  size_t outbytesleft = 2048;
-  char *outbuf = (char *) malloc (outbytesleft);
+  if (ps->reader)
+    return eit_reader_next (ps->reader, data, len);
+  if (eit_file_load (&ps->in, fn))
+    return -1;
+  *data = ps->in.data;
+  *len = ps->in.len;
+  return 0;
+}
 
-  char *code_table;
-  size_t inc = get_code_table (p, len, &code_table);
+// gibt die Daten einer .eit Datei im gewählten Format nach ps->out aus
+int parse_file (struct s_parse_state *ps, const char *fn)
+{
+  if (input_type != INPUT_EIT)
+    return parse_stream (ps, fn);
 
-  // get_code_table gibt die Anzahl Zeichen zurück, die für die code Tabelle verwendet wurden (zwischen 0 und 3 Byte)
-  //printf ("DEBUG: inc = %zi, code_table = '%s'\n", inc, code_table);
-  p += inc;
-  len -= inc;
+  begin_record (ps->out);
 
-  iconv_t cd = iconv_open ("UTF−8", code_table);
-  if (cd == (iconv_t) -1)
+  // unveränderte Datei: Ausgabe des letzten Laufs übernehmen
+  struct stat st;
+  char cacheable = cache && ! stat (fn, &st);
+  if (cacheable && eit_cache_get (cache, fn, &st, ps->out))
     {
-      fprintf (stderr, "iconv_open failed: %i = '%s'\n", errno, strerror (errno));
-      exit (-1);
+      if (ps->stats)
+        ps->stats->cache_hits++;
+      return 0;
     }
 
-  static char *bytes_left = 0;
+  size_t start = ps->out->len;
 
-  if (append && bytes_left)
+  if (output_format == OUTPUT_JSON)
+    output_json_head (ps->out, fn, NULL);
+
+  uint64_t t = stats_begin (ps);
+  const uint8_t *data;
+  size_t len;
+  if (load_file (ps, fn, &data, &len))
+    {
+      put_error_record (ps->out, fn, "error opening file");
+      return 1;
+    }
+  t = stats_end (ps, EIT_STAGE_READ, t);
+  if (ps->stats)
+    ps->stats->bytes += len;
+
+  struct eit_event ev;
+  int ret = eit_parse (data, len, &ev, &ps->ctx);
+  stats_end (ps, EIT_STAGE_PARSE, t);
+  const char *errmsg = ret ? eit_ctx_errmsg (&ps->ctx) : NULL;
+  put_event (ps, fn, NULL, &ev, errmsg);
+  if (! ps->reader)
+    eit_file_release (&ps->in);
+
+  // Dateien mit Fehlern kommen nicht in den Cache, sonst fehlte beim nächsten Lauf der Exit-Status
+  if (ret)
     {
-      size_t num_bytes_left = strlen (bytes_left);
-      p -= num_bytes_left;
-      strncpy (p, bytes_left, num_bytes_left);
+      report_error (fn, "", &ev, errmsg);
+      return 1;
     }
 
-  if (bytes_left)
-    free (bytes_left);
-  bytes_left = 0;
+  if (cacheable && ! ps->out->failed)
+    eit_cache_put (cache, fn, &st, ps->out->data + start, ps->out->len - start);
+  return 0;
+}
 
-  char *pout = outbuf;
-  char *pin = p;
+/*
+  -r DIR: alle .eit Dateien (bzw. .ts bei --input=ts, alle Dateien bei --input=sections) unterhalb von DIR sammeln
+*/
+static const char *collect_suffix = ".eit";
 
-  // copy machen und die letzten Zeichen anzeigen
-  //~ uint8_t temp[len + 1];
-  //~ strncpy (temp, p, len);
-  //~ temp[len] = 0;
-  //~ fflush (stdout);
-  //~ fprintf (stderr, "temp = '%s'\n", temp);
-  //~ fprintf (stderr, "%#x\n", temp[len - 3]);
-  //~ fprintf (stderr, "%#x\n", temp[len - 2]);
-  //~ fprintf (stderr, "%#x\n", temp[len - 1]);
-  //~ fprintf (stderr, "#x\n", temp[len]);
+static char **found_files = NULL;
+static size_t num_found_files = 0;
+static size_t max_found_files = 0;
 
-  iconv (cd, NULL, NULL, &pout, &outbytesleft);
-  size_t nconv = iconv (cd, &pin, &len, &pout, &outbytesleft);
+int collect_eit (const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) ftwbuf;
 
-  if (nconv == (size_t) -1)
+  size_t len = strlen (fpath);
+  size_t suffix_len = strlen (collect_suffix);
+  if (typeflag == FTW_F && len > suffix_len && ! strcasecmp (fpath + len - suffix_len, collect_suffix))
     {
-      if (errno == EINVAL)
-        {
-          // das kann vorkommen, wenn im "Sonderzeichen" auf extended_event_descriptor gesplittet wurde
-          // z.B. ./samples/20190218_2139__ProSieben__The_Big_Bang_Theory.eit
-          bytes_left = strndup (pin, len);
-        }
-      else
+      if (num_found_files == max_found_files)
         {
-          fprintf (stderr, "ERRROR: iconv failed with code %i: '%s'", errno, strerror (errno));
-
-          if (errno == EILSEQ)
+          max_found_files = max_found_files ? 2 * max_found_files : 256;
+          found_files = realloc (found_files, max_found_files * sizeof (char *));
+          if (! found_files)
             {
-              fprintf (stderr, ": invalid multibyte sequence '%s' at index %i\n", pin, (uint8_t*) pin - p);
+              perror ("realloc");
               exit (-1);
             }
-          else if (errno == E2BIG)
-            {
-              fprintf (stderr, ": output buffer too small\n");
-              exit (-1);
-            }
-          else
-            fprintf (stderr, "\n");
         }
+      found_files[num_found_files++] = strdup (fpath);
     }
+  else if (typeflag == FTW_DNR)
+    fprintf (stderr, "WARNING: cannot read directory %s\n", fpath);
 
-  *pout = 0;
+  return 0;
+}
 
-  //printf ("outbuf = '%s'\n", outbuf);
-  //assert (nconv == 0);
-  //printf ("%s", outbuf);
+int cmp_filenames (const void *a, const void *b)
+{
+  return strcmp (*(char * const *) a, *(char * const *) b);
+}
 
-  // FIXME: Die CR/LF Ersetzung sollte man besser vorher machen
-  // andererseits steht da, das wäre die utf-8 sequence...
+/*
+  -j N: die Dateien werden von N Threads in eigene Puffer geparst
+  und in der Reihenfolge der Kommandozeile ausgegeben, damit das JSON deterministisch bleibt
+*/
+struct s_job
+{
+  const char *fn;
+  struct outbuf out;
+  int status;
+  char done;
+};
 
-  // wtf? 0xC28A ist wohl CR/LF, Seite 130 Annex A
+struct s_pool
+{
+  struct s_job *jobs;
+  size_t num_jobs;
+  size_t next;      // nächster noch nicht vergebener Job
+  size_t written;   // Anzahl bereits ausgegebener Jobs
+  size_t window;    // so viele Jobs dürfen dem Ausgeben vorauslaufen
+  char abort;
+  struct eit_run_stats stats;   // --stats: Summe der beendeten Threads
+
+  pthread_mutex_t lock;
+  pthread_cond_t job_done;
+  pthread_cond_t job_written;
+};
 
-  //~ for (unsigned int k = 0; k < (len - (code_table > 0)); ++k)
-  //~ {
-  //~ // FIMXE: check for buffer end
-  //~ if (   p[k] == 0xC2
-  //~ && k +1 < (len - (code_table > 0))
-  //~ && p[k+1] == 0x8A)
-  //~ k++; //ignore CR/LF
-  //~ else
-  //~ printf ("%c", p[k]);
-  //~ }
+void *parse_worker (void *arg)
+{
+  struct s_pool *pool = arg;
+
+  struct eit_run_stats stats;
+  memset (&stats, 0, sizeof (stats));
+
+  struct s_parse_state ps;
+  ps.can_flush = 0;
+  ps.stats = run_stats ? &stats : NULL;
+  ps.reader = NULL;
+  ps.store = NULL;
+  ps.store_fn = NULL;
+  eit_ctx_init (&ps.ctx);
+  eit_ctx_set_fields (&ps.ctx, output_fields);
+  if (ps.stats)
+    eit_ctx_set_stats (&ps.ctx, &ps.stats->lib);
+  eit_file_init (&ps.in);
+
+  pthread_mutex_lock (&pool->lock);
+  for (;;)
+    {
+      while (! pool->abort
+             && pool->next < pool->num_jobs
+             && pool->next >= pool->written + pool->window)
+        pthread_cond_wait (&pool->job_written, &pool->lock);
 
+      if (pool->abort || pool->next >= pool->num_jobs)
+        break;
 
-  if (iconv_close (cd) != 0)
-    perror ("iconv_close");
+      struct s_job *job = &pool->jobs[pool->next++];
+      pthread_mutex_unlock (&pool->lock);
 
-  print_JSON_escaped (outbuf);
+      ps.out = &job->out;
+      job->status = parse_file (&ps, job->fn);
+      stats.files++;
+      stats.files_with_errors += (job->status > 0);
 
-  free (outbuf);
+      pthread_mutex_lock (&pool->lock);
+      job->done = 1;
+      pthread_cond_broadcast (&pool->job_done);
+    }
+  if (ps.stats)
+    eit_run_stats_add (&pool->stats, &stats);
+  pthread_mutex_unlock (&pool->lock);
 
+  eit_ctx_free (&ps.ctx);
+  eit_file_free (&ps.in);
+  return NULL;
 }
 
-int main (int argc, char *argv[])
+// Rückgabe wie parse_file, für alle Dateien zusammen
+int parse_files_parallel (const char **files, size_t num_files, int num_threads)
 {
-  // geargineer: counter fuer die short events eingefuehrt, um diese im json unterscheiden zu koennen
-  int shortevent_count = 0;
-  if (argc < 2)
+  struct s_pool pool;
+  memset (&pool, 0, sizeof (pool));
+  pool.jobs = calloc (num_files, sizeof (struct s_job));
+  if (! pool.jobs)
     {
-      fprintf (stderr, "ERROR: No input file...\n\nUSAGE: %s EIT\n", argv[0]);
-      exit (-1);
+      perror ("calloc");
+      return -1;
+    }
+  pool.num_jobs = num_files;
+  pool.window = 4 * num_threads;
+  for (size_t k = 0; k < num_files; ++k)
+    pool.jobs[k].fn = files[k];
+
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.job_done, NULL);
+  pthread_cond_init (&pool.job_written, NULL);
+
+  pthread_t threads[num_threads];
+  int num_started = 0;
+  for (; num_started < num_threads; ++num_started)
+    if (pthread_create (&threads[num_started], NULL, parse_worker, &pool) != 0)
+      break;
+
+  int ret = (num_started > 0)? 0 : -1;
+  if (ret)
+    fprintf (stderr, "ERROR: could not start worker threads\n");
+
+  char failed = 0;
+  for (size_t k = 0; k < num_files && ! ret; ++k)
+    {
+      struct s_job *job = &pool.jobs[k];
+
+      pthread_mutex_lock (&pool.lock);
+      while (! job->done)
+        pthread_cond_wait (&pool.job_done, &pool.lock);
+      pthread_mutex_unlock (&pool.lock);
+
+      if (flush_output (&job->out) || job->status < 0)
+        ret = -1;
+      if (job->status > 0)
+        failed = 1;
+      outbuf_free (&job->out);
+
+      pthread_mutex_lock (&pool.lock);
+      pool.written++;
+      pool.abort = (ret != 0);
+      pthread_cond_broadcast (&pool.job_written);
+      pthread_mutex_unlock (&pool.lock);
     }
 
-  int num_files = argc - 1;
+  for (int k = 0; k < num_started; ++k)
+    pthread_join (threads[k], NULL);
+  if (run_stats)
+    eit_run_stats_add (run_stats, &pool.stats);
 
-  if (num_files > 1)
-    printf ("[\n");
+  for (size_t k = 0; k < num_files; ++k)
+    outbuf_free (&pool.jobs[k].out);
+  free (pool.jobs);
 
-  FILE *fp;
-  for (int k = 1; k < argc; ++k)
-    {
-      const char *fn = argv[k];
-      // print opening bracket
-      printf (" {\n");
-
-      printf ("  \"filename\": \"%s\",\n", fn);
+  pthread_cond_destroy (&pool.job_written);
+  pthread_cond_destroy (&pool.job_done);
+  pthread_mutex_destroy (&pool.lock);
+  return ret ? ret : failed;
+}
 
-      fp = fopen (fn, "rb");
-      if (!fp)
+int parse_files (const char **files, size_t num_files)
+{
+  struct outbuf out;
+  outbuf_init (&out);
+
+  struct s_parse_state ps;
+  ps.out = &out;
+  ps.can_flush = 1;
+  ps.stats = run_stats;
+  eit_ctx_init (&ps.ctx);
+  eit_ctx_set_fields (&ps.ctx, output_fields);
+  if (ps.stats)
+    eit_ctx_set_stats (&ps.ctx, &ps.stats->lib);
+  eit_file_init (&ps.in);
+  ps.reader = NULL;
+  ps.store = NULL;
+  ps.store_fn = NULL;
+  if (prefetch_depth)
+    {
+      ps.reader = eit_reader_open (files, num_files, prefetch_depth);
+      if (! ps.reader)
         {
-          fprintf (stderr, "error opening file %s\n", fn);
-          exit(-1);
+          fprintf (stderr, "ERROR: --prefetch: %s\n", strerror (errno));
+          eit_ctx_free (&ps.ctx);
+          outbuf_free (&out);
+          return -1;
         }
+    }
 
-      // Die EITs die bei mir so rumliegen, haben max 1100 byte
-#define BUF_SIZE 2000
-      uint8_t buf[BUF_SIZE];
-      size_t num = fread (buf, 1, BUF_SIZE, fp);
-      //printf ("  \"num_bytes\": %i,\n", num);
-
-      if (num == BUF_SIZE)
+  int ret = 0;
+  for (size_t k = 0; k < num_files && ret >= 0; ++k)
+    {
+      int r = parse_file (&ps, files[k]);
+      if (ps.stats)
         {
-          fprintf (stderr, "ERROR: Buffer zu klein. Möglicherweise ist das gar kein EIT...\n");
-          exit (-1);
+          ps.stats->files++;
+          ps.stats->files_with_errors += (r > 0);
         }
+      if (r)
+        ret = r;
+      if (flush_output (&out))
+        ret = -1;
+    }
 
-      fclose(fp);
-
-      uint8_t *p = buf;
+  eit_reader_close (ps.reader);
+  eit_ctx_free (&ps.ctx);
+  eit_file_free (&ps.in);
+  outbuf_free (&out);
+  return ret;
+}
 
-      // 5.2.4 Event Information Table (EIT), Seite 35:
-      int event_id = p[0] << 8 | p[1];
-      p += 2;
+// --serve: "?FROM TO" liefert die gespeicherten Events mit FROM <= start_time_unix < TO
+static void serve_query (struct s_parse_state *ps, const char *query, struct outbuf *out)
+{
+  const char *error = NULL;
+  char *end, *end_to;
+  long long from = strtoll (query, &end, 10);
+  long long to = strtoll (end, &end_to, 10);
+  if (! ps->store)
+    error = "no events stored, start --serve with input files";
+  else if (end == query || end_to == end || *end_to)
+    error = "invalid query, expected ?FROM TO (unix time)";
+  else if (eit_store_query (ps->store, from, to, output_format, output_fields, out) < 0)
+    error = "out of memory";
+
+  if (error)
+    {
+      outbuf_puts (out, "{\"error\":\"");
+      outbuf_puts (out, error);
+      outbuf_puts (out, "\"}\n");
+    }
+}
 
-      struct s_start_time st;
-      uint8_t r = parse_start_time (p, num - (p - buf), &st);
-      p += r;
+// --serve: parst path, die Events ersetzen die bisher unter dem normalisierten Pfad gespeicherten
+static void store_file (struct s_parse_state *ps, const char *path)
+{
+  // ohne realpath (z.B. Datei fehlt) meldet parse_file den Fehler, es kommen keine Events dazu
+  char *real = realpath (path, NULL);
+  ps->store_fn = real ? real : path;
+  eit_store_remove_file (ps->store, ps->store_fn);
+  parse_file (ps, path);
+  ps->store_fn = NULL;
+  free (real);
+}
 
-      struct s_duration dur;
-      r = parse_duration (p, num - (p - buf), &dur);
-      p += r;
+// --serve: eine Anfrage mit dem Kontext des Servers, iconv descriptors und Arena bleiben über alle Anfragen erhalten
+static void serve_request (void *arg, const char *path, const uint8_t *data, size_t len, struct outbuf *out)
+{
+  struct s_parse_state *ps = arg;
+  ps->out = out;
+  if (path && path[0] == '?')
+    {
+      serve_query (ps, path + 1, out);
+      return;
+    }
+  if (path)
+    {
+      if (ps->store)
+        store_file (ps, path);
+      else
+        parse_file (ps, path);
+      return;
+    }
 
-      // running_status
-      // undefined = 0, not_running, starts_in_a_few_seconds, pausing, running, serive_off_air, reserved1, reserved2
+  struct eit_event ev;
+  int ret = eit_parse (data, len, &ev, &ps->ctx);
+  const char *errmsg = ret ? eit_ctx_errmsg (&ps->ctx) : NULL;
+  output_event (out, output_format, output_fields, "-", NULL, &ev, errmsg);
+  if (ret)
+    report_error ("-", "", &ev, errmsg);
+}
 
-      uint8_t running_status = p[0] & 0x03;
-      uint8_t free_CA_mode   = (p[0] >> 3) & 0x01;
-      uint16_t descriptors_loop_length = (p[0] & 0xF0) << 8 | p[1];
+// mit files werden diese vorab in den Speicher eingelesen und können nach Zeitraum abgefragt werden
+int serve (const char *sock_path, const char **files, size_t num_files)
+{
+  struct s_parse_state ps;
+  ps.out = NULL;
+  ps.can_flush = 0;
+  ps.stats = NULL;
+  ps.reader = NULL;
+  ps.store = NULL;
+  ps.store_fn = NULL;
+  eit_ctx_init (&ps.ctx);
+  eit_ctx_set_fields (&ps.ctx, output_fields);
+  eit_file_init (&ps.in);
+
+  int ret = 0;
+  if (num_files)
+    {
+      ps.store = eit_store_new ();
+      if (! ps.store)
+        ret = -1;
+
+      // die Datensätze selbst werden nicht gebraucht, Fehler stehen schon auf stderr
+      struct outbuf out;
+      outbuf_init (&out);
+      ps.out = &out;
+      for (size_t k = 0; k < num_files && ! ret; ++k)
+        {
+          store_file (&ps, files[k]);
+          if (out.failed)
+            ret = -1;
+          out.len = 0;
+        }
+      outbuf_free (&out);
+      if (ret)
+        fprintf (stderr, "ERROR: out of memory storing the events\n");
+      else
+        fprintf (stderr, "stored %zu events from %zu files (%.1f MB)\n", eit_store_num_events (ps.store),
+                 num_files, eit_store_memory (ps.store) / 1e6);
+    }
 
-      printf ("  \"event_id\": %i,\n", event_id);
-      printf ("  \"start_time\": \"%i/%i/%i %02i:%02i:%02i\",\n", st.Y, st.M, st.D, st.t.hour, st.t.minute, st.t.second);
-      printf ("  \"duration\": \"%02i:%02i:%02i\",\n", dur.hour, dur.minute, dur.second);
-      printf ("  \"running_status\": %i,\n", running_status);
-      printf ("  \"free_CA_mode\": %i,\n", free_CA_mode);
+  if (! ret)
+    {
+      ret = eit_serve (sock_path, serve_request, &ps);
+      if (ret)
+        fprintf (stderr, "ERROR: cannot listen on '%s': %s\n", sock_path, strerror (errno));
+    }
 
-      //printf ("descriptors_loop_length = %i\n", descriptors_loop_length);
+  eit_store_free (ps.store);
+  eit_ctx_free (&ps.ctx);
+  eit_file_free (&ps.in);
+  return ret;
+}
 
-      p += 2;
+// --watch: jede neue Datei sofort ausgeben
+static int watch_file (void *arg, const char *path)
+{
+  struct s_parse_state *ps = arg;
+  parse_file (ps, path);
+  if (flush_output (ps->out) || fflush (stdout))
+    return -1;
+  return 0;
+}
 
-      // Seite 39, Tabelle 12
-#define SHORT_EVENT_DESCRIPTOR 0x4d
-#define EXTENDED_EVENT_DESCRIPTOR 0x4e
-#define COMPONENT_DESCRIPTOR 0x50
+int watch (const char **dirs, int num_dirs)
+{
+  struct outbuf out;
+  outbuf_init (&out);
+
+  struct s_parse_state ps;
+  ps.out = &out;
+  ps.can_flush = 1;
+  ps.stats = NULL;
+  ps.reader = NULL;
+  ps.store = NULL;
+  ps.store_fn = NULL;
+  eit_ctx_init (&ps.ctx);
+  eit_ctx_set_fields (&ps.ctx, output_fields);
+  eit_file_init (&ps.in);
+
+  int ret = eit_watch (dirs, num_dirs, collect_suffix, watch_file, &ps);
+  if (ret)
+    fprintf (stderr, "ERROR: watching failed: %s\n", strerror (errno));
+
+  eit_ctx_free (&ps.ctx);
+  eit_file_free (&ps.in);
+  outbuf_free (&out);
+  return ret;
+}
 
-      uint8_t last_descriptor_tag = 0;
-      char first_descriptor = 1;
-      while (p < (buf + num))
-        {
-          uint8_t descriptor_tag = p[0];
-          uint8_t descriptor_length = p[1];
+// --dedup: Gruppen gleicher Aufnahmen statt der Events ausgeben
+int dedup (const char **files, size_t num_files, double threshold)
+{
+  struct eit_dedup *d = eit_dedup_new (threshold);
+  if (! d)
+    {
+      perror ("eit_dedup_new");
+      return -1;
+    }
 
-          //fprintf (stderr, "Bytes left: %li\n", buf + num - p);
-          //fprintf (stderr, "descriptor_tag = %#x\n", descriptor_tag);
-          //fprintf (stderr, "descriptor_length = %i\n", descriptor_length);  // Länge der folgenden Daten in Bytes
+  struct eit_ctx ctx;
+  eit_ctx_init (&ctx);
+  eit_ctx_set_fields (&ctx, EIT_FIELD_TEXT | EIT_FIELD_EXTENDED);
+  struct eit_file in;
+  eit_file_init (&in);
 
-          p += 2;
+  int ret = 0;
+  for (size_t k = 0; k < num_files && ret >= 0; ++k)
+    {
+      if (eit_file_load (&in, files[k]))
+        {
+          fprintf (stderr, "error opening file %s: %s\n", files[k], strerror (errno));
+          ret = 1;
+          continue;
+        }
 
-          // Seite 87, Kapitel 6.2.37 : Short event descriptor
-          if (descriptor_tag == SHORT_EVENT_DESCRIPTOR)
-            {
-              shortevent_count += 1;
-              printf ("  \"short_event_descriptor_%i\":\n  {\n", shortevent_count);
-              printf ("    \"iso_639_2_language_code\": \"%c%c%c\",\n", p[0], p[1], p[2]);
+      // auch mit Fehlern zählt, was gelesen werden konnte
+      struct eit_event ev;
+      if (eit_parse (in.data, in.len, &ev, &ctx))
+        {
+          report_error (files[k], "", &ev, eit_ctx_errmsg (&ctx));
+          ret = 1;
+        }
+      if (eit_dedup_add (d, files[k], &ev))
+        {
+          perror ("eit_dedup_add");
+          ret = -1;
+        }
+      eit_file_release (&in);
+    }
 
-              p += 3;
+  struct outbuf out;
+  outbuf_init (&out);
+  if (ret >= 0 && (eit_dedup_write (d, &out, output_format == OUTPUT_NDJSON) || outbuf_flush (&out, stdout)))
+    ret = -1;
 
-              uint8_t event_name_length = p[0];
-              //printf ("    \"event_name_length\": %i,\n", event_name_length);
-              p += 1;
+  outbuf_free (&out);
+  eit_file_free (&in);
+  eit_ctx_free (&ctx);
+  eit_dedup_free (d);
+  return ret;
+}
 
-              // printf ("    \"event_name_%i\": \"", shortevent_count);
-              printf ("    \"event_name\": \"");
-              dump_text (p, event_name_length, 0);
-              printf ("\",\n");
+// --index OUT: Wörter von event_name, text, extended text und items aller Dateien
+int build_index (const char **files, size_t num_files, const char *index_fn)
+{
+  struct eit_index_writer *w = eit_index_writer_new ();
+  if (! w)
+    {
+      perror ("eit_index_writer_new");
+      return -1;
+    }
 
-              p += event_name_length;
+  struct eit_ctx ctx;
+  eit_ctx_init (&ctx);
+  eit_ctx_set_fields (&ctx, EIT_FIELD_EVENT_NAME | EIT_FIELD_TEXT | EIT_FIELD_EXTENDED);
+  struct eit_file in;
+  eit_file_init (&in);
 
-              uint8_t text_length = p[0];
-              //printf ("    \"text_length\": %i,\n", text_length);
-              p += 1;
+  int ret = 0;
+  for (size_t k = 0; k < num_files && ret >= 0; ++k)
+    {
+      if (eit_file_load (&in, files[k]))
+        {
+          fprintf (stderr, "error opening file %s: %s\n", files[k], strerror (errno));
+          ret = 1;
+          continue;
+        }
 
-              printf ("    \"text\": \"");
-              dump_text (p, text_length, 0);
-              // Change! 20251120 - if program exits AFTER this descriptor, the comma in printf makes the json invalid --> removed
-//              printf ("\"\n  },\n");
-              printf ("\"\n  },\n");
-              p += text_length;
-            }
-          // Seite 64, Kapitel 6.2.15 : Extended event descriptor
-          else if (descriptor_tag == EXTENDED_EVENT_DESCRIPTOR)
-            {
-              //printf ("EXTENDED_EVENT_DESCRIPTOR\n");
+      struct eit_event ev;
+      if (eit_parse (in.data, in.len, &ev, &ctx))
+        {
+          report_error (files[k], "", &ev, eit_ctx_errmsg (&ctx));
+          ret = 1;
+        }
 
-              uint8_t descriptor_number = p[0] >> 4;
-              uint8_t last_descriptor_number = p[0] & 0x0F;
-              p += 1;
+      int err = eit_index_add_file (w, files[k]);
+      for (size_t j = 0; j < ev.num_short_events && ! err; ++j)
+        err = eit_index_add_text (w, ev.short_events[j].event_name)
+              || eit_index_add_text (w, ev.short_events[j].text);
+      for (size_t j = 0; j < ev.num_extended_events && ! err; ++j)
+        {
+          const struct eit_extended_event *ee = &ev.extended_events[j];
+          err = eit_index_add_text (w, ee->text);
+          for (size_t i = 0; i < ee->num_items && ! err; ++i)
+            err = eit_index_add_text (w, ee->items[i].item);
+        }
+      if (err)
+        {
+          perror ("eit_index_add_text");
+          ret = -1;
+        }
+      eit_file_release (&in);
+    }
 
-#ifdef DEBUG
-              printf ("descriptor_number = %i\n", descriptor_number);
-              printf ("last_descriptor_number = %i\n", last_descriptor_number);
-#endif
+  if (ret >= 0 && eit_index_write (w, index_fn))
+    {
+      fprintf (stderr, "ERROR: writing index '%s' failed: %s\n", index_fn, strerror (errno));
+      ret = -1;
+    }
 
-              if (descriptor_number == 0)
-                {
-                  printf ("  \"extended_event_descriptor\":\n  {\n");
-                  printf ("    \"iso_639_2_language_code\": \"%c%c%c\",\n", p[0], p[1], p[2]);
-                  // IWi 20251107: um den text im extended descriptor zu identifizieren den key von 'text' auf 'text_extended' gesetzt
-                  // printf ("    \"text_extended\": \"");
-                  printf ("    \"text\": \"");
-                }
+  eit_file_free (&in);
+  eit_ctx_free (&ctx);
+  eit_index_writer_free (w);
+  return ret;
+}
 
-              p += 3;
+// --query INDEX: Dateien, die alle Wörter aus args enthalten
+int query_index (const char *index_fn, char **args, int num_args)
+{
+  // wie beim Erzeugen zerlegen, damit Groß-/Kleinschreibung und Satzzeichen gleich behandelt werden
+  char words[num_args * 16 + 1][EIT_TOKEN_MAX_LEN + 1];
+  const char *terms[num_args * 16 + 1];
+  int num_terms = 0;
+  for (int k = 0; k < num_args; ++k)
+    {
+      struct eit_token t;
+      eit_token_init (&t, args[k]);
+      while (num_terms < num_args * 16 && eit_token_next (&t))
+        {
+          memcpy (words[num_terms], t.word, t.len + 1);
+          terms[num_terms] = words[num_terms];
+          num_terms++;
+        }
+    }
+  if (! num_terms)
+    {
+      fprintf (stderr, "ERROR: no search word with at least %i characters\n", EIT_TOKEN_MIN_CHARS);
+      return -1;
+    }
 
-              // Tabelle 53, Seite 64
-              uint8_t length_of_items = *(p++);   // kann auch 0 sein
-              // printf ("length_of_items = %i\n", length_of_items);
+  struct eit_index *ix = eit_index_open (index_fn);
+  if (! ix)
+    {
+      fprintf (stderr, "ERROR: cannot open index '%s': %s\n", index_fn, strerror (errno));
+      return -1;
+    }
 
-              if (length_of_items > 0)
-                {
-                  fprintf (stderr, "Noch nicht implementiert...\n");
-                  exit (-1);
-                }
+  uint32_t *ids;
+  long num = eit_index_query (ix, terms, num_terms, &ids);
+  if (num < 0)
+    {
+      fprintf (stderr, "ERROR: query on '%s' failed (out of memory or broken index)\n", index_fn);
+      eit_index_close (ix);
+      return -1;
+    }
 
-              uint8_t text_length = *(p++);
-              //printf ("text_length = %i\n", text_length);
+  struct outbuf out;
+  outbuf_init (&out);
+  if (output_format != OUTPUT_NDJSON)
+    outbuf_puts (&out, num ? "[\n" : "[]\n");
+  for (long k = 0; k < num; ++k)
+    {
+      const char *fn = eit_index_filename (ix, ids[k]);
+      if (! fn)
+        continue;
+      outbuf_puts (&out, (output_format == OUTPUT_NDJSON)? "{\"filename\":\"" : (k ? ",\n \"" : " \""));
+      outbuf_put_json_escaped (&out, fn);
+      outbuf_puts (&out, (output_format == OUTPUT_NDJSON)? "\"}\n" : "\"");
+    }
+  if (output_format != OUTPUT_NDJSON && num)
+    outbuf_puts (&out, "\n]\n");
 
-              dump_text (p, text_length, descriptor_number > 0);
+  int ret = outbuf_flush (&out, stdout);
+  outbuf_free (&out);
+  free (ids);
+  eit_index_close (ix);
+  return ret;
+}
 
-              // Sind wir am Ende?
-              if (descriptor_number == last_descriptor_number)
-                // geargineer 20251120 added comma to terminate json-structure before next structure
-                printf ("\"\n  },\n");
+void usage (const char *prog)
+{
+  fprintf (stderr, "USAGE: %s [-r DIR] [-j N] [--input=TYPE] [--format=FMT] [--fields=LIST] [--cache FILE] [--prefetch[=N]] [--stats] [EIT...]\n"
+           "       %s --serve SOCKET [--input=TYPE] [--fields=LIST] [--cache FILE | -r DIR | EIT...]\n"
+           "       %s --watch DIR [-o FILE] [--input=TYPE] [--fields=LIST] [--cache FILE]\n"
+           "       %s --index OUT [-r DIR] [EIT...]\n"
+           "       %s --query INDEX WORD...\n\n", prog, prog, prog, prog, prog);
+  fprintf (stderr, "  -r DIR        parse all .eit files below DIR (recursive), output is a JSON array\n");
+  fprintf (stderr, "  --input=TYPE  eit (default, Enigma2 .eit files), sections (EIT section dump)\n"
+           "                or ts (transport stream, EIT on PID 0x12), one record per event\n");
+  fprintf (stderr, "  -j N          parse with N threads, output order stays the same\n");
+  fprintf (stderr, "  --format=FMT  json (default), ndjson (one compact object per line)\n"
+           "                or bin (uint32 big endian length + MessagePack map per file)\n");
+  fprintf (stderr, "  --fields=LIST only output (and decode) these fields, comma separated list of\n"
+           "                event_id, start_time, duration, running_status, free_CA_mode, event_name, text,\n"
+           "                extended, component, content, parental_rating\n");
+  fprintf (stderr, "  --cache FILE  reuse the output of files whose size and mtime did not change\n");
+  fprintf (stderr, "  --serve SOCKET  answer requests on a unix socket (one path, or \"@LEN\" followed by\n"
+           "                LEN bytes of an .eit file, per line) with ndjson records and an empty line;\n"
+           "                with input files their events are kept in memory and \"?FROM TO\" lists\n"
+           "                those with FROM <= start_time_unix < TO\n");
+  fprintf (stderr, "  --watch DIR   write an ndjson record for every .eit file that is written or moved\n"
+           "                below DIR (may be given more than once), until SIGINT/SIGTERM\n");
+  fprintf (stderr, "  --dedup[=J]   instead of the events write groups of recordings whose text words\n"
+           "                have a Jaccard similarity of at least J (default 0.5)\n");
+  fprintf (stderr, "  --index OUT   write an inverted index of the words in event_name, text and extended text\n");
+  fprintf (stderr, "  --query INDEX list the files containing all WORDs, WORD* matches words starting with WORD\n");
+  fprintf (stderr, "  --export FILE write all events column by column (dictionary encoded strings) to FILE,\n"
+           "                format see eit_columns.h\n");
+  fprintf (stderr, "  --prefetch[=N] read up to N files (default 64) ahead with io_uring or threads,\n"
+           "                for cold caches and network filesystems\n");
+  fprintf (stderr, "  --stats       print counters and per stage timings as JSON to stderr at the end\n");
+  fprintf (stderr, "  -o FILE       write the output to FILE instead of stdout (appended with --watch)\n");
+}
 
-              p += text_length;
+int main (int argc, char *argv[])
+{
+  char recursive = 0;
+  int num_threads = 1;
+  const char *format_arg = NULL;        // --format wie angegeben, NULL = Standard des Modus
+
+  // -r Verzeichnisse, werden erst nach --input durchsucht
+  const char *dirs[argc];
+  int num_dirs = 0;
+
+  const char *cache_fn = NULL;
+  const char *serve_path = NULL;
+  const char *output_fn = NULL;
+  double dedup_threshold = 0;   // 0 = kein --dedup
+  const char *index_fn = NULL;
+  const char *query_fn = NULL;
+  const char *export_fn = NULL;
+  char stats = 0;
+  uint64_t start_ns = eit_run_stats_now ();
+
+  // --watch Verzeichnisse
+  const char *watch_dirs[argc];
+  int num_watch_dirs = 0;
+
+  static const struct option long_options[] =
+  {
+    {"input", required_argument, NULL, 'i'},
+    {"format", required_argument, NULL, 'f'},
+    {"fields", required_argument, NULL, 'F'},
+    {"cache", required_argument, NULL, 'c'},
+    {"serve", required_argument, NULL, 's'},
+    {"watch", required_argument, NULL, 'w'},
+    {"output", required_argument, NULL, 'o'},
+    {"dedup", optional_argument, NULL, 'd'},
+    {"index", required_argument, NULL, 'x'},
+    {"query", required_argument, NULL, 'q'},
+    {"export", required_argument, NULL, 'e'},
+    {"stats", no_argument, NULL, 'S'},
+    {"prefetch", optional_argument, NULL, 'P'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int opt;
+  while ((opt = getopt_long (argc, argv, "r:j:o:h", long_options, NULL)) != -1)
+    {
+      switch (opt)
+        {
+        case 'i':
+          if (! strcmp (optarg, "eit"))
+            input_type = INPUT_EIT;
+          else if (! strcmp (optarg, "sections"))
+            input_type = INPUT_SECTIONS;
+          else if (! strcmp (optarg, "ts"))
+            input_type = INPUT_TS;
+          else
+            {
+              fprintf (stderr, "ERROR: unknown input type '%s'\n", optarg);
+              exit (-1);
             }
-          // Seite 46, Kapitel 6.2.8
-          else if (descriptor_tag == COMPONENT_DESCRIPTOR)
+          break;
+        case 'f':
+          if (output_format_from_name (optarg) < 0)
             {
-              uint8_t stream_content_ext = p[0] >> 4;
-              uint8_t stream_content = p[0] & 0x0F;
-              uint8_t component_type = p[1];
-              uint8_t component_tag = p[2];
-
-#ifdef DEBUG
-              printf ("COMPONENT_DESCRIPTOR\n");
-              printf ("stream_content_ext = %i\n", stream_content_ext);
-              printf ("stream_content = %i\n", stream_content);
-              printf ("component_type = %i\n", component_type);
-              printf ("component_tag = %i\n", component_tag);
-              printf ("iso_639_2_language_code = \"%c%c%c\"\n", p[3], p[4], p[5]);
-#endif
-              p += 6;
-
-              //if (last_descriptor_tag != COMPONENT_DESCRIPTOR)
-              //  printf ("  \"component_descriptor\":\n  {\n");
-
-              //printf ("    \"text\": \"");
-              // hier keine Länge, muss man sich wohl aus descriptor_length berechnen
-              size_t len = descriptor_length - 6;
-              //dump_text (p, len, 0);
-
-              //printf ("\"\n  }\n");
-              p += len;
-
+              fprintf (stderr, "ERROR: unknown format '%s'\n", optarg);
+              exit (-1);
             }
-          else
+          output_format = output_format_from_name (optarg);
+          format_arg = optarg;
+          break;
+        case 'F':
+          if (output_fields_from_list (optarg) < 0)
             {
-              int bytes_left = buf + num - p;
-              if (bytes_left > 0)
-                {
-                  fprintf (stderr, "Unbekannter descriptor_tag %#x, descriptor_length=%i, bytes left = %i\n", descriptor_tag, descriptor_length, bytes_left);
-                  //print emtpy structure to get valid json befor exiting
-                  printf ("  \"empty_structure\":\n");
-                  printf ("  {\n");
-                  printf ("    \"dummy\": \"nix\" \n");
-                  printf ("  }\n");
-
-                  // print closing bracket for valid json
-                  printf (" }\n");
-                  exit (-1);
-                }
+              fprintf (stderr, "ERROR: invalid field list '%s'\n", optarg);
+              exit (-1);
+            }
+          output_fields = output_fields_from_list (optarg);
+          break;
+        case 'c':
+          cache_fn = optarg;
+          break;
+        case 's':
+          serve_path = optarg;
+          break;
+        case 'w':
+          watch_dirs[num_watch_dirs++] = optarg;
+          break;
+        case 'o':
+          output_fn = optarg;
+          break;
+        case 'x':
+          index_fn = optarg;
+          break;
+        case 'q':
+          query_fn = optarg;
+          break;
+        case 'e':
+          export_fn = optarg;
+          break;
+        case 'S':
+          stats = 1;
+          break;
+        case 'P':
+          prefetch_depth = optarg ? atoi (optarg) : 64;
+          if (prefetch_depth < 1 || prefetch_depth > 4096)
+            {
+              fprintf (stderr, "ERROR: invalid prefetch depth '%s'\n", optarg);
+              exit (-1);
             }
+          break;
+        case 'd':
+          dedup_threshold = optarg ? strtod (optarg, NULL) : 0.5;
+          if (! (dedup_threshold > 0 && dedup_threshold <= 1))
+            {
+              fprintf (stderr, "ERROR: invalid similarity '%s', expected 0 < J <= 1\n", optarg);
+              exit (-1);
+            }
+          break;
+        case 'r':
+          recursive = 1;
+          dirs[num_dirs++] = optarg;
+          break;
+        case 'j':
+          num_threads = atoi (optarg);
+          if (num_threads < 1 || num_threads > 256)
+            {
+              fprintf (stderr, "ERROR: invalid number of threads '%s'\n", optarg);
+              exit (-1);
+            }
+          break;
+        default:
+          usage (argv[0]);
+          exit (opt == 'h'? 0 : -1);
+        }
+    }
+
+  if (input_type == INPUT_TS)
+    collect_suffix = ".ts";
+  else if (input_type == INPUT_SECTIONS)
+    collect_suffix = "";
+
+  for (int k = 0; k < num_dirs; ++k)
+    if (nftw (dirs[k], collect_eit, 32, FTW_PHYS) != 0)
+      {
+        fprintf (stderr, "ERROR: walking '%s' failed: %s\n", dirs[k], strerror (errno));
+        exit (-1);
+      }
+
+  // gefundene Dateien sortiert, damit die Ausgabe unabhängig von der Verzeichnisreihenfolge ist
+  qsort (found_files, num_found_files, sizeof (char *), cmp_filenames);
+
+  int num_args = argc - optind;
+  // die restlichen Argumente sind bei --query Suchwörter
+  if (query_fn)
+    {
+      if (num_args < 1 || recursive || serve_path || num_watch_dirs || dedup_threshold > 0 || index_fn)
+        {
+          fprintf (stderr, "ERROR: --query takes only search words\n");
+          exit (-1);
+        }
+      int r = query_index (query_fn, argv + optind, num_args);
+      exit (r < 0 ? -1 : r);
+    }
 
-          last_descriptor_tag = descriptor_tag;
-          first_descriptor = 0;
+  if (num_watch_dirs && (num_args > 0 || recursive))
+    {
+      fprintf (stderr, "ERROR: --watch takes no input files\n");
+      exit (-1);
+    }
+  if (serve_path && (num_args > 0 || recursive) && cache_fn)
+    {
+      fprintf (stderr, "ERROR: --serve with input files keeps all events in memory, not with --cache\n");
+      exit (-1);
+    }
+  if ((serve_path != NULL) + (num_watch_dirs > 0) + (dedup_threshold > 0) + (index_fn != NULL) + (export_fn != NULL) > 1)
+    {
+      fprintf (stderr, "ERROR: --serve, --watch, --dedup, --index and --export cannot be combined\n");
+      exit (-1);
+    }
+  if (stats && (serve_path || num_watch_dirs || dedup_threshold > 0 || index_fn))
+    {
+      fprintf (stderr, "ERROR: --stats only with normal parsing or --export\n");
+      exit (-1);
+    }
+  if (prefetch_depth && (input_type != INPUT_EIT || serve_path || num_watch_dirs || dedup_threshold > 0 || index_fn))
+    {
+      fprintf (stderr, "ERROR: --prefetch only with --input=eit and normal parsing or --export\n");
+      exit (-1);
+    }
+  if (prefetch_depth && (cache_fn || num_threads > 1))
+    {
+      fprintf (stderr, "ERROR: --prefetch reads every file in order, not with --cache or -j\n");
+      exit (-1);
+    }
+  if (stats)
+    {
+      run_stats = calloc (1, sizeof (struct eit_run_stats));
+      if (! run_stats)
+        {
+          perror ("calloc");
+          exit (-1);
+        }
+    }
+  if (export_fn && cache_fn)
+    {
+      fprintf (stderr, "ERROR: --cache only stores text output, not with --export\n");
+      exit (-1);
+    }
+  if (export_fn)
+    {
+      columns = eit_columns_new ();
+      if (! columns)
+        {
+          perror ("eit_columns_new");
+          exit (-1);
         }
+      // keine Datensätze oder Trennzeichen auf stdout, die Zeilen in Reihenfolge der Dateien
+      output_format = OUTPUT_NDJSON;
+      num_threads = 1;
+    }
+  if ((dedup_threshold > 0 || index_fn) && (input_type != INPUT_EIT || output_format == OUTPUT_BIN))
+    {
+      fprintf (stderr, "ERROR: --dedup and --index need --input=eit and --format=json or ndjson\n");
+      exit (-1);
+    }
+  // die Antworten bzw. nach und nach ausgegebenen Datensätze müssen einzeln abgrenzbar sein
+  if ((serve_path || num_watch_dirs) && format_arg && output_format != OUTPUT_NDJSON)
+    {
+      fprintf (stderr, "ERROR: --serve and --watch write ndjson, not with --format=%s\n", format_arg);
+      exit (-1);
+    }
+  if (serve_path || num_watch_dirs)
+    output_format = OUTPUT_NDJSON;
+
+  // --watch hängt an eine bestehende Ausgabe an, statt sie zu überschreiben
+  if (output_fn && ! freopen (output_fn, num_watch_dirs ? "a" : "w", stdout))
+    {
+      fprintf (stderr, "ERROR: cannot open '%s': %s\n", output_fn, strerror (errno));
+      exit (-1);
+    }
 
-#ifdef DEBUG
-      printf ("End: Bytes left: %li\n", buf + num - p);
-#endif
-      // regular termination of program:
-      printf ("  \"empty_structure\":\n");
-      printf ("  {\n");
-      printf ("    \"dummy\": \"nix\" \n");
-      printf ("  }\n");
+  if (num_args < 1 && ! recursive && ! serve_path && ! num_watch_dirs)
+    {
+      fprintf (stderr, "ERROR: No input file...\n\n");
+      usage (argv[0]);
+      exit (-1);
+    }
 
-      printf (" }%s\n", (k < argc - 1)? "," : "");
+  size_t num_files = num_found_files + num_args;
+  const char **files = malloc ((num_files + 1) * sizeof (char *));
+  if (! files)
+    {
+      perror ("malloc");
+      exit (-1);
     }
-  if (num_files > 1)
+  for (size_t k = 0; k < num_files; ++k)
+    files[k] = (k < (size_t) num_args)? argv[optind + k] : found_files[k - num_args];
+
+  if (cache_fn)
+    {
+      cache = eit_cache_open (cache_fn, output_format | output_fields << 8);
+      if (! cache)
+        {
+          perror ("eit_cache_open");
+          exit (-1);
+        }
+    }
+
+  // aus einem section dump oder Transport Stream kommen beliebig viele Events
+  char is_array = output_format == OUTPUT_JSON && (num_files > 1 || recursive || input_type != INPUT_EIT)
+                 && ! dedup_threshold && ! index_fn && ! export_fn;
+  if (is_array)
+    printf ("[\n");
+
+  int ret;
+  if (serve_path)
+    ret = serve (serve_path, files, num_files);
+  else if (dedup_threshold > 0)
+    ret = dedup (files, num_files, dedup_threshold);
+  else if (index_fn)
+    ret = build_index (files, num_files, index_fn);
+  else if (export_fn)
+    {
+      ret = parse_files (files, num_files);
+      if (ret >= 0 && eit_columns_write (columns, export_fn))
+        {
+          fprintf (stderr, "ERROR: writing '%s' failed: %s\n", export_fn, strerror (errno));
+          ret = -1;
+        }
+      eit_columns_free (columns);
+    }
+  else if (num_watch_dirs)
+    ret = watch (watch_dirs, num_watch_dirs);
+  else if (num_threads > 1 && num_files > 1)
+    ret = parse_files_parallel (files, num_files, num_threads);
+  else
+    ret = parse_files (files, num_files);
+
+  // auch nach einem Fehler speichern, die bis dahin geparsten Dateien bleiben gültig
+  if (cache && eit_cache_close (cache) && ! ret)
+    ret = 1;
+
+  if (run_stats)
+    {
+      eit_run_stats_write (stderr, run_stats, eit_run_stats_now () - start_ns);
+      free (run_stats);
+    }
+
+  // wenn die Ausgabe nicht geschrieben werden konnte, bleibt es bei dem, was schon draußen ist
+  if (ret < 0)
+    exit (-1);
+
+  if (output_format == OUTPUT_JSON && s_records_written)
+    printf ("\n");
+  if (is_array)
     printf ("]\n");
-  return 0;
-}
 
+  free (files);
+  for (size_t k = 0; k < num_found_files; ++k)
+    free (found_files[k]);
+  free (found_files);
 
+  // Dateien mit Fehlern: Ausgabe vollständig, aber Exit-Status 1
+  return ret;
+}
@@ -0,0 +1,305 @@
+/*!
+  \file parse_eit.h
+
+  libparse_eit: Parser für EIT (DVB Event Information Table) Dateien
+  Copyright (C) 2016..2023 Andreas Weber
+
+  Der Parser füllt eine struct eit_event statt JSON auszugeben und kann
+  so direkt in andere Programme gelinkt werden. Aller Zustand liegt in
+  einer struct eit_ctx, verschiedene Threads brauchen also nur jeweils
+  einen eigenen Kontext.
+
+  Beispiel:
+
+    struct eit_ctx ctx;
+    struct eit_event ev;
+
+    eit_ctx_init (&ctx);
+    if (eit_parse (buf, len, &ev, &ctx) != EIT_OK)
+      fprintf (stderr, "%s\n", eit_ctx_errmsg (&ctx));
+    ...
+    eit_ctx_free (&ctx);
+
+  Referenz ist ETSI EN 300 468 V1.16.1, Seitenangaben beziehen sich darauf.
+*/
+
+#ifndef PARSE_EIT_H
+#define PARSE_EIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iconv.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum eit_error
+{
+  EIT_OK = 0,
+  EIT_ERR_TRUNCATED = -1,           // Daten enden mitten in einem Feld
+  EIT_ERR_CODE_TABLE = -2,          // ungültige Auswahl der Zeichentabelle (Annex A)
+  EIT_ERR_ICONV = -3,               // iconv_open für die Zeichentabelle fehlgeschlagen
+  EIT_ERR_CHARSET = -4,             // ungültige Zeichenfolge im Text
+  EIT_ERR_TOO_BIG = -5,             // dekodierter Text zu lang
+  EIT_ERR_NOT_IMPLEMENTED = -6,     // wird derzeit nicht mehr zurückgegeben
+  EIT_ERR_UNKNOWN_DESCRIPTOR = -7,  // wird nicht mehr zurückgegeben, unbekannte descriptor_tag werden übersprungen
+  EIT_ERR_NOMEM = -8,
+  EIT_ERR_NOT_EIT = -9,             // table_id ist keine EIT (0x4E..0x6F)
+  EIT_ERR_CRC = -10                 // CRC_32 der section falsch
+};
+
+#define EIT_NUM_ERRORS 11   // -EIT_ERR_CRC + 1
+
+/*
+  Auswahl für eit_ctx_set_fields. Die Kopfdaten des Events werden immer
+  gelesen, die Bits steuern dort nur, was ein Programm ausgeben soll. Von den
+  Descriptoren werden nicht gewählte Textfelder nicht dekodiert und
+  Descriptoren ganz ohne gewählte Felder nur übersprungen.
+*/
+enum eit_field
+{
+  EIT_FIELD_EVENT_ID = 1 << 0,
+  EIT_FIELD_START_TIME = 1 << 1,
+  EIT_FIELD_DURATION = 1 << 2,
+  EIT_FIELD_RUNNING_STATUS = 1 << 3,
+  EIT_FIELD_FREE_CA_MODE = 1 << 4,
+  EIT_FIELD_EVENT_NAME = 1 << 5,    // short_event_descriptor
+  EIT_FIELD_TEXT = 1 << 6,          // short_event_descriptor
+  EIT_FIELD_EXTENDED = 1 << 7,      // extended_event_descriptor
+  EIT_FIELD_COMPONENT = 1 << 8,     // component_descriptor
+  EIT_FIELD_CONTENT = 1 << 9,       // content_descriptor
+  EIT_FIELD_PARENTAL_RATING = 1 << 10,
+  EIT_FIELD_ALL = (1 << 11) - 1
+};
+
+// 5.2.4, Seite 35: duration und die Uhrzeit der start_time, BCD kodiert
+struct eit_duration
+{
+  int hour;
+  int minute;
+  int second;
+};
+
+// Datum nach Annex C, Y = Jahre seit 1900
+struct eit_start_time
+{
+  int Y;
+  int D;
+  int M;
+
+  struct eit_duration t;   // ist eigentlich die Startzeit, hat aber gleiches Format wie duration
+
+  int64_t unix_time;       // Sekunden seit 1970-01-01 00:00:00 UTC
+  char undefined;          // alle 40 bit "1" (z.B. NVOD reference service), die anderen Felder sind dann 0
+};
+
+// 6.2.37, Seite 87: short_event_descriptor
+struct eit_short_event
+{
+  char language[4];   // iso_639_2_language_code, null-terminiert
+  char *event_name;   // UTF-8, NULL ohne EIT_FIELD_EVENT_NAME
+  char *text;         // UTF-8, NULL ohne EIT_FIELD_TEXT
+};
+
+// 6.2.15, Seite 64: item_description/item Paar, z.B. "Regie" und der Name
+struct eit_extended_item
+{
+  char *description;  // UTF-8
+  char *item;         // UTF-8, über mehrere Descriptoren fortgesetzte items zusammengesetzt
+};
+
+// 6.2.15, Seite 64: über descriptor_number 0..last_descriptor_number zusammengesetzter Text
+struct eit_extended_event
+{
+  char language[4];
+  char *text;         // UTF-8
+
+  size_t num_items;
+  struct eit_extended_item *items;
+};
+
+// 6.2.8, Seite 46: component_descriptor, z.B. Bildformat oder Audiospur
+struct eit_component
+{
+  uint8_t stream_content_ext;
+  uint8_t stream_content;
+  uint8_t component_type;
+  uint8_t component_tag;
+  char language[4];
+  char *text;         // UTF-8
+};
+
+// 6.2.9, Seite 48: ein Eintrag des content_descriptor (Genre)
+struct eit_content
+{
+  uint8_t level_1;    // content_nibble_level_1, siehe eit_content_genre
+  uint8_t level_2;
+  uint8_t user_byte;
+};
+
+// 6.2.28, Seite 83: ein Eintrag des parental_rating_descriptor
+struct eit_parental_rating
+{
+  char country[4];    // country_code, null-terminiert
+  uint8_t rating;     // 0x01..0x0F: Mindestalter rating + 3 Jahre
+};
+
+/*
+  Alle Zeiger zeigen in Speicher des eit_ctx und bleiben bis zum nächsten
+  eit_parse mit demselben Kontext bzw. bis eit_ctx_free gültig.
+*/
+struct eit_event
+{
+  uint16_t event_id;
+  struct eit_start_time start_time;
+  struct eit_duration duration;
+  uint8_t running_status;
+  uint8_t free_CA_mode;
+  uint16_t descriptors_loop_length;
+
+  size_t num_short_events;
+  struct eit_short_event *short_events;
+
+  size_t num_extended_events;
+  struct eit_extended_event *extended_events;
+
+  size_t num_components;
+  struct eit_component *components;
+  size_t num_contents;
+  struct eit_content *contents;
+  size_t num_parental_ratings;
+  struct eit_parental_rating *parental_ratings;
+
+  unsigned num_errors;    // fehlerhafte Descriptoren, der erste Fehler steht in eit_ctx_errmsg
+  unsigned num_skipped_descriptors;   // unbekannte oder nicht gewählte Descriptoren
+};
+
+// 5.2.4, Seite 35: Kopf einer event_information_section
+struct eit_section
+{
+  uint8_t table_id;
+  uint16_t section_length;
+  uint16_t service_id;
+  uint8_t version_number;
+  uint8_t current_next_indicator;
+  uint8_t section_number;
+  uint8_t last_section_number;
+  uint16_t transport_stream_id;
+  uint16_t original_network_id;
+  uint8_t segment_last_section_number;
+  uint8_t last_table_id;
+
+  const uint8_t *events;    // Event-Schleife, zeigt in den Puffer der section
+  size_t events_len;
+};
+
+#define EIT_ICONV_CACHE_SIZE 32
+
+/*
+  Zähler für eit_ctx_set_stats (parse_eit --stats), die Werte werden nur
+  erhöht. Ohne stats kostet das je Descriptor und Textfeld einen Vergleich.
+*/
+struct eit_stats
+{
+  uint64_t descriptors[256];      // gelesene Descriptoren nach descriptor_tag, auch übersprungene
+  uint64_t extended_chains[17];   // [k]: extended_event Ketten aus k Descriptoren (höchstens 16)
+  uint64_t errors[EIT_NUM_ERRORS];  // alle Fehler (nicht nur der erste) nach -enum eit_error
+
+  // dekodierte Textfelder je Zeichentabelle, davon über iconv statt der eingebauten Decoder
+  struct
+  {
+    const char *code_table;
+    uint64_t texts;
+    uint64_t iconv;
+  } code_tables[EIT_ICONV_CACHE_SIZE];
+  int num_code_tables;
+
+  uint64_t decode_ns;             // Zeit in der Textdekodierung (CLOCK_MONOTONIC)
+};
+
+struct eit_arena_chunk;
+
+// interne Felder, nur über die eit_* Funktionen benutzen
+struct eit_ctx
+{
+  // iconv conversion descriptors, pro code_table nur einmal geöffnet
+  struct
+  {
+    const char *code_table;
+    iconv_t cd;
+  } iconv_cache[EIT_ICONV_CACHE_SIZE];
+  int iconv_cache_used;
+
+  // Arena für die Strings des aktuellen eit_event
+  struct eit_arena_chunk *arena;
+  struct eit_arena_chunk *arena_cur;
+
+  struct eit_short_event *short_events;
+  size_t max_short_events;
+  struct eit_extended_event *extended_events;
+  size_t max_extended_events;
+  struct eit_component *components;
+  size_t max_components;
+  struct eit_content *contents;
+  size_t max_contents;
+  struct eit_parental_rating *parental_ratings;
+  size_t max_parental_ratings;
+
+  unsigned fields;    // enum eit_field
+  struct eit_stats *stats;  // NULL = keine Statistik
+
+  // erster Fehler des letzten Aufrufs und Anzahl aller Fehler
+  int error;
+  unsigned num_errors;
+  char errmsg[256];
+};
+
+void eit_ctx_init (struct eit_ctx *ctx);
+void eit_ctx_free (struct eit_ctx *ctx);
+
+// Oder-Verknüpfung von enum eit_field, Voreinstellung ist EIT_FIELD_ALL
+void eit_ctx_set_fields (struct eit_ctx *ctx, unsigned fields);
+
+// zählt ab jetzt in stats mit (NULL schaltet ab), stats gehört dem Aufrufer
+void eit_ctx_set_stats (struct eit_ctx *ctx, struct eit_stats *stats);
+
+/*
+  Parst eine .eit Datei (Enigma2 Layout, beginnt direkt mit event_id) aus buf.
+  Rückgabe EIT_OK oder der erste aufgetretene enum eit_error Wert. Fehlerhafte
+  oder unbekannte Descriptoren werden übersprungen (out->num_errors), out enthält
+  auch im Fehlerfall alles, was gelesen werden konnte.
+*/
+int eit_parse (const uint8_t *buf, size_t len, struct eit_event *out, struct eit_ctx *ctx);
+
+/*
+  Liest den Kopf einer EIT section (beginnt mit table_id, 3 + section_length Byte
+  inklusive CRC_32) und prüft die CRC_32, bei EIT_ERR_CRC sollte die section
+  verworfen werden. Die Events in sec->events werden dann nacheinander mit
+  eit_parse_event geparst.
+*/
+int eit_parse_section (const uint8_t *buf, size_t len, struct eit_section *sec, struct eit_ctx *ctx);
+
+/*
+  Parst das erste Event der Event-Schleife einer section, *consumed ist danach
+  die Länge des Events (12 Byte + descriptors_loop_length). Wie bei eit_parse
+  gelten die Zeiger in out nur bis zum nächsten Aufruf mit demselben Kontext.
+*/
+int eit_parse_event (const uint8_t *buf, size_t len, size_t *consumed, struct eit_event *out, struct eit_ctx *ctx);
+
+// CRC-32/MPEG-2 (ISO/IEC 13818-1 Annex A), über eine ganze gültige section 0
+uint32_t eit_crc32 (const uint8_t *p, size_t len);
+
+// Beschreibung des ersten Fehlers des letzten Aufrufs mit Details, z.B. dem unbekannten descriptor_tag
+const char *eit_ctx_errmsg (const struct eit_ctx *ctx);
+
+const char *eit_strerror (int err);
+
+// englischer Name des Genres nach Tabelle 29, z.B. "Movie/Drama"
+const char *eit_content_genre (uint8_t level_1);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif